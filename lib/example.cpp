@@ -18,6 +18,7 @@
 #include <chrono>
 #include <csignal>
 #include <cstdio>
+#include <mutex>
 #include <thread>
 
 static std::atomic<bool> g_running { true };
@@ -32,6 +33,9 @@ class MyGameServer : public reflector::Server {
 public:
     using Server::Server;
 
+    // Held by the game loop while it updates the scene and records the frame
+    std::mutex frameMutex;
+
 protected:
     reflector::PerfMetrics onGetPerf() override
     {
@@ -86,20 +90,89 @@ protected:
             return std::nullopt;
         }
     }
+
+    std::optional<uint64_t> onGetEntityVersion(uintptr_t) override
+    {
+        // Example entities never change, so one version covers them all
+        return 1;
+    }
+
+    void onBatch(const std::function<void()>& run) override
+    {
+        // Answer the whole /api/batch between two frames
+        std::lock_guard<std::mutex> lock(frameMutex);
+        run();
+    }
 };
 
 int main()
 {
     std::signal(SIGINT, onSignal);
 
+    // State read by the gauge and route below, declared before the server so
+    // it outlives every callback
+    std::atomic<int> pendingPackets { 0 };
+    uint64_t frameCount = 0;
+
     MyGameServer server(7700);
+    server.setPrecomputeBudget(0.1f); // rebuild cached responses when idle
     server.start();
 
+    // A pull-only metric sampled at 20 Hz regardless of who is polling,
+    // served at /api/gauges
+    server.addGauge("network.queue", [&pendingPackets] { return pendingPackets.load(); }, 20.0f);
+
+    // A custom endpoint run on the game thread (inside recordFrame), so it
+    // can read game-loop state such as this counter without locking
+    reflector::RoutePolicy onGameThread;
+    onGameThread.mainThread = true;
+    server.route("/api/example/stats", [&frameCount](const reflector::RouteRequest&, reflector::JsonOut& out) {
+        out.beginObject().key("frames").uint(frameCount).endObject();
+        return 200;
+    },
+        onGameThread);
+
+    // A slow query answered from a background thread; the handler returns at
+    // once and the request's worker waits without using CPU
+    server.routeAsync("/api/example/slow", [&server](reflector::RouteRequest, reflector::RouteResponder res) {
+        server.runInBackground([res] {
+            std::this_thread::sleep_for(std::chrono::milliseconds(200));
+            res.respond(200, [](reflector::JsonOut& out) { out.beginObject().key("ready").boolean(true).endObject(); });
+        });
+    });
+
+    // A second loop on its own thread, timed separately at /api/loops
+    reflector::FrameLoop& simulation = server.addLoop("simulation", 60.0f);
+    reflector::FrameLoop& network = server.addLoop("network", 20.0f);
+    std::thread networkThread([&network, &pendingPackets] {
+        while (g_running) {
+            network.begin();
+            pendingPackets = (pendingPackets + 7) % 32;
+            std::this_thread::sleep_for(std::chrono::milliseconds(3));
+            network.end();
+            std::this_thread::sleep_for(std::chrono::milliseconds(47));
+        }
+    });
+
     std::printf("Press Ctrl+C to stop.\n");
+    auto last = std::chrono::steady_clock::now();
     while (g_running) {
-        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        {
+            std::lock_guard<std::mutex> lock(server.frameMutex);
+            simulation.begin();
+            std::this_thread::sleep_for(std::chrono::milliseconds(4));
+            simulation.end();
+
+            // Feed per-frame timings to /api/perf/frames
+            auto now = std::chrono::steady_clock::now();
+            server.recordFrame(std::chrono::duration<float, std::milli>(now - last).count());
+            last = now;
+            ++frameCount;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(12));
     }
 
+    networkThread.join();
     server.stop();
     std::printf("Stopped.\n");
     return 0;
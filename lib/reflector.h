@@ -20,12 +20,24 @@
 #define REFLECTOR_H
 
 #include <cstdint>
+#include <functional>
+#include <memory>
 #include <optional>
 #include <string>
+#include <string_view>
 #include <vector>
 
 #include <nlohmann/json.hpp>
 
+// Coroutine async route handlers (RouteTask) when built as C++20; the
+// callback form of Server::routeAsync works either way
+#if defined(__cpp_impl_coroutine) && defined(__has_include)
+#if __has_include(<coroutine>)
+#include <coroutine>
+#define REFLECTOR_COROUTINES
+#endif
+#endif
+
 // ---------------------------------------------------------------------------
 // Public API
 // ---------------------------------------------------------------------------
@@ -92,27 +104,410 @@ namespace reflector {
 
 namespace detail {
     struct ServerAccess;
+    struct ServerState;
+    struct WorldState;
+    struct HostState;
+    struct LoopState;
+    struct JobGraphState;
+    struct CustomRoute;
+    struct AsyncToken;
 }
 
+class Host;
+
+// Streaming JSON writer handed to custom route handlers (Server::route).
+// Appends straight to a per-thread response buffer that is reused across
+// requests, with the same number formatting and string escaping as the
+// built-in endpoints, and puts in the commas between members and elements
+// itself. Nesting is limited to 64 levels: a handler that goes deeper
+// gets a 500 in place of its response.
+class JsonOut {
+public:
+    JsonOut(const JsonOut&) = delete;
+    JsonOut& operator=(const JsonOut&) = delete;
+
+    JsonOut& beginObject();
+    JsonOut& endObject();
+    JsonOut& beginArray();
+    JsonOut& endArray();
+    JsonOut& key(std::string_view name);
+
+    JsonOut& string(std::string_view v);
+    JsonOut& number(double v);
+    JsonOut& number(float v); // at float precision: 16.6f is written as 16.6
+    JsonOut& integer(int64_t v);
+    JsonOut& uint(uint64_t v);
+    JsonOut& boolean(bool v);
+    JsonOut& null();
+    JsonOut& numbers(const float* v, size_t n); // an array of floats
+    JsonOut& json(const nlohmann::json& v); // any value, through nlohmann (slower)
+    JsonOut& raw(std::string_view json); // an already serialized value
+
+private:
+    friend struct detail::ServerAccess;
+    JsonOut(std::string& out, int precision);
+    void separate();
+    void open(char bracket);
+    void close(char bracket);
+
+    static constexpr int kMaxDepth = 64; // levels tracked by `started_`
+
+    std::string& out_;
+    int precision_;
+    int depth_ = 0;
+    uint64_t started_ = 0; // bit d set once level d has an element
+    bool afterKey_ = false;
+    bool tooDeep_ = false; // nested past kMaxDepth; the output is discarded
+};
+
+// What a custom route handler sees of its request
+struct RouteRequest {
+    std::string_view path; // e.g. "/api/navmesh/3", without any Host mount prefix
+    std::string_view query; // raw query string ("" if none)
+
+    // Decoded value of query parameter `name`, if present
+    std::optional<std::string> param(const char* name) const;
+};
+
+// Writes the response body to `out` and returns the HTTP status
+using RouteHandler = std::function<int(const RouteRequest& request, JsonOut& out)>;
+
+// Answers one request to an async route (Server::routeAsync), from any
+// thread and at any time. Copies share the request: the first respond() or
+// fail() answers it and later calls do nothing. If every copy is dropped
+// without answering, the request fails with 500.
+//
+// The request's CivetWeb worker thread waits until it is answered, so an
+// unanswered responder still costs a worker, and counts against the same
+// limit as ?wait= requests (4 on a standalone server, a Host's thread
+// count minus 2): past it, new async requests get 503 without running.
+// Async routes free the handler's thread, not the connection's.
+class RouteResponder {
+public:
+    // Runs `write` on the calling thread to produce the body
+    void respond(int status, const std::function<void(JsonOut&)>& write) const;
+    void fail(int status, const std::string& message) const;
+
+    // True once the request was answered, timed out or the server stopped;
+    // long work can check it to give up early
+    bool done() const;
+
+private:
+    friend struct detail::ServerAccess;
+    RouteResponder() = default;
+
+    std::shared_ptr<detail::AsyncToken> token_;
+};
+
+// Starts the work for the request and returns; take both by value, they
+// stay valid for as long as the handler keeps the responder
+using AsyncRouteHandler = std::function<void(RouteRequest request, RouteResponder responder)>;
+
+#ifdef REFLECTOR_COROUTINES
+// Return type of a coroutine async route handler, which co_awaits
+// Server::resumeOnMainThread() or resumeInBackground() to move between
+// threads. It runs as soon as it is called and frees itself when it
+// finishes; if it throws, the dropped responder answers 500. While it is
+// suspended the request still holds a worker thread (see RouteResponder).
+struct RouteTask {
+    struct promise_type {
+        RouteTask get_return_object() noexcept { return {}; }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() noexcept { }
+        void unhandled_exception() noexcept { }
+    };
+};
+#endif
+
+// How Server::route serves a custom endpoint
+struct RoutePolicy {
+    // Cache each URL's body (query string included) until this returns a
+    // different value, e.g. a counter bumped whenever the data behind the
+    // route changes. Responses then carry an ETag and If-None-Match gets a
+    // 304. Called on every request, so keep it cheap.
+    std::function<uint64_t()> generation;
+
+    // Concurrent requests for the same URL share one run of the handler
+    bool singleFlight = false;
+
+    // Run the handler on the game thread, inside the next recordFrame(),
+    // so it can read game state without locking. Requests fail with 503 if
+    // no frame is recorded within 5 seconds.
+    bool mainThread = false;
+};
+
+// A named loop with its own cadence (simulation tick, network tick, a
+// streaming thread...). Call begin()/end() around each iteration from the
+// loop's own thread; spans go to a lock-free single-writer ring, so serving
+// never blocks the loop. Served at /api/loops.
+class FrameLoop {
+public:
+    ~FrameLoop();
+
+    void begin();
+    void end();
+
+    const std::string& name() const { return name_; }
+
+private:
+    friend class Server;
+    friend struct detail::ServerAccess;
+    FrameLoop(std::string name, float targetHz);
+
+    std::string name_;
+    float targetHz_;
+    std::unique_ptr<detail::LoopState> state_;
+};
+
+// Profiles a job system: each frame's DAG of jobs run on a worker pool.
+// Call beginFrame()/endFrame() around each frame from the thread that drives
+// it, and the rest from whichever thread spawns, waits on or runs a job,
+// passing that thread's index. Each index records into its own lock-free
+// single-writer ring, so recording never blocks or contends; threads that
+// aren't workers but spawn jobs (the main thread) need an index of their own.
+// Served at /api/jobs, which computes each frame's critical path, worker
+// utilization and idle gaps.
+class JobGraph {
+public:
+    ~JobGraph();
+
+    void beginFrame();
+    void endFrame();
+
+    // `job` is any id unique among the frame's live jobs (a pointer will
+    // do); an id may be reused once its job finished. `name` must stay valid
+    // for the server's lifetime (a string literal). Calls with a `worker`
+    // outside [0, workers) are ignored.
+    void spawn(int worker, uint64_t job, const char* name);
+    void depend(int worker, uint64_t job, uint64_t prerequisite); // after spawn(job)
+    void start(int worker, uint64_t job);
+    void finish(int worker, uint64_t job);
+
+    const std::string& name() const { return name_; }
+    int workers() const { return workers_; }
+
+private:
+    friend class Server;
+    friend struct detail::ServerAccess;
+    JobGraph(std::string name, int workers);
+
+    std::string name_;
+    int workers_;
+    std::unique_ptr<detail::JobGraphState> state_;
+};
+
+// One simulation instance (e.g. a match) served under /api/w/<name>/ next to
+// the server's own scene. Each world has its own scene and entity caches and
+// its own frame history, so requests against one never touch another's.
+class World {
+public:
+    World();
+    virtual ~World();
+
+    // Same as Server::recordFrame / mark / setTargetFrameRate, for this
+    // world's series.
+    void recordFrame(float frameTimeMs);
+    void mark(const std::string& name);
+    void setTargetFrameRate(float hz);
+
+protected:
+    virtual PerfMetrics onGetPerf() = 0;
+    virtual std::vector<SceneNode> onGetScene() = 0;
+    virtual std::optional<EntityInfo> onGetEntity(uintptr_t id) = 0;
+    virtual std::optional<uint64_t> onGetEntityVersion(uintptr_t /*id*/) { return std::nullopt; }
+
+private:
+    friend struct detail::ServerAccess;
+    std::unique_ptr<detail::WorldState> state_;
+};
+
 class Server {
 public:
     explicit Server(int port = 7700);
     virtual ~Server();
 
+    // Listens on its own port with its own threads. Not needed (and a no-op)
+    // for a server mounted on a Host; stop() on a mounted server unmounts it.
     void start();
     void stop();
 
-    bool isRunning() const { return ctx_ != nullptr; }
+    bool isRunning() const;
+
+    // Per-frame timing feed served at /api/perf/frames. Call once per frame
+    // from the game loop; safe to call from one thread while serving. This is
+    // also the frame boundary at which /api/export forks its snapshot.
+    void recordFrame(float frameTimeMs);
+
+    // Named marker attached to the next recorded frame (e.g. "level_loaded").
+    void mark(const std::string& name);
+
+    // Display rate that /api/perf/pacing counts missed cadence slots against
+    // (default 60; 0 disables). Applies to frames recorded afterwards.
+    void setTargetFrameRate(float hz);
+
+    // Digits after the decimal point for floating-point values in responses
+    // (trailing zeros dropped), or -1 for the shortest form that round-trips.
+    // Requests can override it with ?precision=N.
+    void setFloatPrecision(int digits);
+
+    // Registers (or replaces) a world served under /api/w/<name>/ and listed
+    // at /api/worlds. Names must be non-empty and contain no '/'. Safe to call
+    // while serving; a removed world stays alive until its in-flight requests
+    // finish.
+    bool addWorld(const std::string& name, std::shared_ptr<World> world);
+    void removeWorld(const std::string& name);
+
+    // Registers a named loop (or returns the one already registered under
+    // `name`). The reference stays valid for the server's lifetime.
+    // `targetHz` is informational (0 if unknown).
+    FrameLoop& addLoop(const std::string& name, float targetHz = 0.0f);
+
+    // Registers a job profiler (or returns the one already registered under
+    // `name`) with `workers` recording threads. The reference stays valid
+    // for the server's lifetime.
+    JobGraph& addJobGraph(const std::string& name, int workers);
+
+    // Registers (or replaces) a pull-only metric such as pool occupancy or a
+    // queue depth. `sample` is called at `rateHz` (0 < rateHz <= 1000) from
+    // the server's sampler thread, whether or not anyone is polling, and the
+    // timestamped values are served at /api/gauges. Names must be non-empty
+    // and contain no '/'. After removeGauge() returns, the callback is no
+    // longer running and won't be called again. The same holds for every
+    // gauge once stop() returns, until the server is started (or mounted)
+    // again. Callbacks may add and remove gauges (a callback's own removal
+    // then takes effect from the next pass) but must not call stop().
+    bool addGauge(const std::string& name, std::function<double()> sample, float rateHz = 10.0f);
+    void removeGauge(const std::string& name);
+
+    // Share of one core (0-1) that a low-priority background thread may
+    // spend, while no requests are being served, rebuilding the cached
+    // /api/scene body and the most recently requested versioned entities
+    // after they change, so the next request finds them ready. The thread
+    // calls onGetScene/onGetEntityVersion/onGetEntity (and those of the
+    // worlds) like a request would. 0, the default, disables it.
+    void setPrecomputeBudget(float cpuShare);
+
+    // Registers a custom GET endpoint at `path` (e.g. "/api/navmesh", which
+    // also receives sub-paths such as "/api/navmesh/3"), served like the
+    // built-in ones: on the same worker threads, with ?precision=N and the
+    // server's float precision applied to `out`. Fails if `path` doesn't
+    // start with '/' or overlaps a built-in or custom route, that is, equals
+    // it or extends it past a '/' in either direction (so neither "/api" nor
+    // "/api/scene/x" can be registered). Safe to call while serving; routes
+    // stay registered for the server's lifetime.
+    bool route(const std::string& path, RouteHandler handler, RoutePolicy policy = {});
+
+    // Like route(), but the handler answers through `responder`, possibly
+    // later and from another thread, so it can hand slow work to
+    // runOnMainThread() or runInBackground() and return at once (or, as a
+    // RouteTask coroutine, co_await resumeOnMainThread() and the like). The
+    // policy's mainThread starts the handler on the game thread. CivetWeb
+    // serves each connection on one worker thread until it is answered, so
+    // the worker still waits, without using CPU, for up to 30 seconds
+    // (then 503), and counts against the same limit as ?wait= requests.
+    bool routeAsync(const std::string& path, AsyncRouteHandler handler, RoutePolicy policy = {});
+
+    // Runs `job` on the game thread inside the next recordFrame()
+    void runOnMainThread(std::function<void()> job);
+
+    // Runs `job` on one of the server's two background threads (started on
+    // first use). Jobs still queued when the server is destroyed are dropped.
+    void runInBackground(std::function<void()> job);
+
+#ifdef REFLECTOR_COROUTINES
+    // co_await in a RouteTask to continue on the game thread (inside the
+    // next recordFrame) or on a background thread
+    struct Resume {
+        Server* server;
+        bool mainThread;
+
+        bool await_ready() const noexcept { return false; }
+        void await_resume() const noexcept { }
+        void await_suspend(std::coroutine_handle<> handle)
+        {
+            // Owns the suspended coroutine until it resumes, so a job that
+            // never runs destroys it instead of leaking it
+            struct Suspended {
+                std::coroutine_handle<> handle;
+                ~Suspended()
+                {
+                    if (handle)
+                        handle.destroy();
+                }
+            };
+            auto suspended = std::make_shared<Suspended>();
+            suspended->handle = handle;
+            auto resume = [suspended] {
+                auto h = suspended->handle;
+                suspended->handle = nullptr;
+                h.resume();
+            };
+            if (mainThread)
+                server->runOnMainThread(resume);
+            else
+                server->runInBackground(resume);
+        }
+    };
+    Resume resumeOnMainThread() { return { this, true }; }
+    Resume resumeInBackground() { return { this, false }; }
+#endif
 
 protected:
     virtual PerfMetrics onGetPerf() = 0;
     virtual std::vector<SceneNode> onGetScene() = 0;
     virtual std::optional<EntityInfo> onGetEntity(uintptr_t id) = 0;
 
+    // Optional: a counter that changes whenever the entity's properties do.
+    // When provided, entity responses carry an ETag, repeat requests are
+    // served from a cache of serialized bodies and If-None-Match gets a 304.
+    // /api/merkle, whose tree is rebuilt once per frame, then only
+    // re-serializes the entity when its version moves.
+    virtual std::optional<uint64_t> onGetEntityVersion(uintptr_t /*id*/) { return std::nullopt; }
+
+    // Optional: runs the sub-requests of one /api/batch call, which call the
+    // methods above (and those of any worlds). Override to hold your own lock
+    // around `run`, or otherwise keep the frame from advancing, so that every
+    // result comes from the same frame; the response says whether they did.
+    virtual void onBatch(const std::function<void()>& run) { run(); }
+
 private:
     friend struct detail::ServerAccess;
+    friend class Host;
+    bool addRoute(std::shared_ptr<detail::CustomRoute> route);
+
+    int port_;
+    ::mg_context* ctx_ = nullptr;
+    Host* host_ = nullptr;
+    std::unique_ptr<detail::ServerState> state_;
+};
+
+// One listener and worker pool shared by any number of Servers, each mounted
+// under a path prefix: a server mounted at "/physics" answers
+// /physics/api/scene and so on. /api/mounts lists the prefixes. Mounting and
+// unmounting are safe while the host is running; unmounting waits for the
+// server's in-flight requests.
+class Host {
+public:
+    explicit Host(int port = 7700, int threads = 4);
+    ~Host();
+
+    void start();
+    void stop();
+
+    bool isRunning() const { return ctx_ != nullptr; }
+
+    // `prefix` is "" or "/name" (no trailing '/'). Fails if the prefix is
+    // taken or the server is already started or mounted.
+    bool mount(const std::string& prefix, Server& server);
+    void unmount(Server& server);
+
+private:
+    friend class Server;
     int port_;
+    int threads_;
     ::mg_context* ctx_ = nullptr;
+    std::unique_ptr<detail::HostState> state_;
 };
 
 } // namespace reflector
@@ -130,15 +525,406 @@ private:
 #include <civetweb.h>
 
 #include <algorithm>
+#include <atomic>
 #include <charconv>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
 #include <cstdio>
 #include <cstring>
+#include <deque>
+#include <list>
+#include <map>
+#include <mutex>
+#include <shared_mutex>
 #include <string>
+#include <thread>
 #include <unordered_map>
 
+#if defined(__linux__)
+#include <cerrno>
+#include <csignal>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+// Vectorized string escaping: AVX2 when the build enables it, SSE2 on any
+// x86-64, a scalar scan elsewhere
+#if defined(__AVX2__)
+#define REFLECTOR_AVX2
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define REFLECTOR_SSE2
+#endif
+#if defined(REFLECTOR_AVX2) || defined(REFLECTOR_SSE2)
+#include <immintrin.h>
+#endif
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
 namespace reflector {
 namespace detail {
 
+    // ---------------------------------------------------------------------------
+    // JSON writer: appends straight to a byte buffer, for hot paths that
+    // bypass nlohmann's DOM
+    // ---------------------------------------------------------------------------
+
+    class JsonWriter {
+    public:
+        // `precision`: digits after the decimal point for floating-point
+        // values, or -1 for the shortest form that round-trips
+        explicit JsonWriter(std::string& out, int precision = -1)
+            : out_(out)
+            , precision_(precision)
+        {
+        }
+
+        void raw(const char* s, size_t n) { out_.append(s, n); }
+        void raw(const char* s) { out_.append(s); }
+
+        void uint(uint64_t v)
+        {
+            char buf[20];
+            auto [end, ec] = std::to_chars(buf, buf + sizeof(buf), v);
+            out_.append(buf, static_cast<size_t>(end - buf));
+        }
+
+        void integer(int64_t v)
+        {
+            char buf[20];
+            auto [end, ec] = std::to_chars(buf, buf + sizeof(buf), v);
+            out_.append(buf, static_cast<size_t>(end - buf));
+        }
+
+        // Floats keep float precision: 16.6f is written as 16.6, not as the
+        // 16.600000381469727 its double promotion would give
+        void number(float v)
+        {
+            char buf[kMaxRealChars];
+            out_.append(buf, static_cast<size_t>(formatReal(buf, v) - buf));
+        }
+
+        void number(double v)
+        {
+            char buf[kMaxRealChars];
+            out_.append(buf, static_cast<size_t>(formatReal(buf, v) - buf));
+        }
+
+        // Comma-separated run of values, formatted in place in one batch
+        void numbers(const float* v, size_t n)
+        {
+            if (n == 0)
+                return;
+            size_t pos = out_.size();
+            out_.resize(pos + n * (kMaxRealChars + 1));
+            char* p = &out_[pos];
+            p = formatReal(p, v[0]);
+            for (size_t i = 1; i < n; ++i) {
+                *p++ = ',';
+                p = formatReal(p, v[i]);
+            }
+            out_.resize(static_cast<size_t>(p - out_.data()));
+        }
+
+        // Quoted and escaped the way nlohmann::json::dump() does (UTF-8 is
+        // passed through, control characters become \uXXXX). Runs that need
+        // no escaping are found a vector at a time and copied in one append.
+        void string(const std::string& s) { string(s.data(), s.size()); }
+
+        void string(const char* s, size_t n)
+        {
+            const char* end = s + n;
+            out_.push_back('"');
+            while (s < end) {
+                size_t clean = cleanPrefix(s, static_cast<size_t>(end - s));
+                out_.append(s, clean);
+                s += clean;
+                if (s == end)
+                    break;
+                escape(*s++);
+            }
+            out_.push_back('"');
+        }
+
+        // Any nlohmann value. With `floats`, floating-point numbers are known
+        // to have been stored from floats and are written at float precision.
+        void json(const nlohmann::json& v, bool floats)
+        {
+            switch (v.type()) {
+            case nlohmann::json::value_t::boolean:
+                v.get<bool>() ? raw("true", 4) : raw("false", 5);
+                break;
+            case nlohmann::json::value_t::number_integer:
+                integer(v.get<int64_t>());
+                break;
+            case nlohmann::json::value_t::number_unsigned:
+                uint(v.get<uint64_t>());
+                break;
+            case nlohmann::json::value_t::number_float:
+                if (floats)
+                    number(static_cast<float>(v.get<double>()));
+                else
+                    number(v.get<double>());
+                break;
+            case nlohmann::json::value_t::string:
+                string(v.get_ref<const std::string&>());
+                break;
+            case nlohmann::json::value_t::array:
+                out_.push_back('[');
+                for (size_t i = 0; i < v.size(); ++i) {
+                    if (i > 0)
+                        out_.push_back(',');
+                    json(v[i], floats);
+                }
+                out_.push_back(']');
+                break;
+            case nlohmann::json::value_t::object: {
+                out_.push_back('{');
+                bool first = true;
+                for (auto it = v.begin(); it != v.end(); ++it) {
+                    if (!first)
+                        out_.push_back(',');
+                    first = false;
+                    string(it.key());
+                    out_.push_back(':');
+                    json(it.value(), floats);
+                }
+                out_.push_back('}');
+                break;
+            }
+            default:
+                raw("null", 4);
+            }
+        }
+
+    private:
+        static constexpr size_t kMaxRealChars = 48;
+
+        static bool needsEscape(unsigned char c) { return c < 0x20 || c == '"' || c == '\\'; }
+
+        // Length of the leading run of `s` that can be copied verbatim
+        static size_t cleanPrefix(const char* s, size_t n)
+        {
+            size_t i = 0;
+#if defined(REFLECTOR_AVX2)
+            const __m256i quote = _mm256_set1_epi8('"');
+            const __m256i backslash = _mm256_set1_epi8('\\');
+            const __m256i control = _mm256_set1_epi8(0x1f);
+            for (; i + 32 <= n; i += 32) {
+                __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(s + i));
+                __m256i hit = _mm256_or_si256(
+                    _mm256_or_si256(_mm256_cmpeq_epi8(v, quote), _mm256_cmpeq_epi8(v, backslash)),
+                    _mm256_cmpeq_epi8(_mm256_min_epu8(v, control), v)); // v <= 0x1f
+                uint32_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(hit));
+                if (mask)
+                    return i + countTrailingZeros(mask);
+            }
+#endif
+#if defined(REFLECTOR_SSE2)
+            const __m128i quote16 = _mm_set1_epi8('"');
+            const __m128i backslash16 = _mm_set1_epi8('\\');
+            const __m128i control16 = _mm_set1_epi8(0x1f);
+            for (; i + 16 <= n; i += 16) {
+                __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + i));
+                __m128i hit = _mm_or_si128(
+                    _mm_or_si128(_mm_cmpeq_epi8(v, quote16), _mm_cmpeq_epi8(v, backslash16)),
+                    _mm_cmpeq_epi8(_mm_min_epu8(v, control16), v));
+                uint32_t mask = static_cast<uint32_t>(_mm_movemask_epi8(hit));
+                if (mask)
+                    return i + countTrailingZeros(mask);
+            }
+#endif
+            while (i < n && !needsEscape(static_cast<unsigned char>(s[i])))
+                ++i;
+            return i;
+        }
+
+        static unsigned countTrailingZeros(uint32_t mask)
+        {
+#if defined(_MSC_VER) && !defined(__clang__)
+            unsigned long index;
+            _BitScanForward(&index, mask);
+            return static_cast<unsigned>(index);
+#else
+            return static_cast<unsigned>(__builtin_ctz(mask));
+#endif
+        }
+
+        void escape(char c)
+        {
+            switch (c) {
+            case '"':
+                out_.append("\\\"", 2);
+                break;
+            case '\\':
+                out_.append("\\\\", 2);
+                break;
+            case '\b':
+                out_.append("\\b", 2);
+                break;
+            case '\f':
+                out_.append("\\f", 2);
+                break;
+            case '\n':
+                out_.append("\\n", 2);
+                break;
+            case '\r':
+                out_.append("\\r", 2);
+                break;
+            case '\t':
+                out_.append("\\t", 2);
+                break;
+            default: {
+                static const char hex[] = "0123456789abcdef";
+                char esc[6] = { '\\', 'u', '0', '0', hex[(c >> 4) & 0xf], hex[c & 0xf] };
+                out_.append(esc, 6);
+            }
+            }
+        }
+
+        // Writes at most kMaxRealChars. Non-finite values become null as in
+        // nlohmann; magnitudes too large for fixed notation stay shortest.
+        template <typename T>
+        char* formatReal(char* p, T v) const
+        {
+            if (!std::isfinite(v)) {
+                std::memcpy(p, "null", 4);
+                return p + 4;
+            }
+            if (precision_ < 0 || std::fabs(v) >= T(1e15))
+                return std::to_chars(p, p + kMaxRealChars, v).ptr;
+
+            char* end = std::to_chars(p, p + kMaxRealChars, v, std::chars_format::fixed, precision_).ptr;
+            if (precision_ > 0) {
+                while (end[-1] == '0')
+                    --end;
+                if (end[-1] == '.')
+                    --end;
+            }
+            return end;
+        }
+
+        std::string& out_;
+        int precision_;
+    };
+
+    // ---------------------------------------------------------------------------
+    // Per-request phase timing, sent as a Server-Timing header
+    // ---------------------------------------------------------------------------
+
+    enum class Phase { App, // the application's callbacks and route handlers
+        Hash, // scene change detection
+        Build, // scene tree and Merkle tree construction
+        Serialize,
+        Wait }; // long polls, game-thread and single-flight waits
+
+    static constexpr const char* kPhaseNames[] = { "app", "hash", "build", "serialize", "wait" };
+    static constexpr size_t kPhases = sizeof(kPhaseNames) / sizeof(kPhaseNames[0]);
+
+    // Phase totals of the request the calling worker is serving. Phases are
+    // exclusive: one timed inside another pauses it, so they never add up to
+    // more than the total. Off outside a request (e.g. on the precompute
+    // thread), where timers don't read the clock.
+    struct RequestTiming {
+        bool on = false;
+        int current = -1; // phase being timed, -1 for none
+        int64_t startNs = 0;
+        int64_t sinceNs = 0; // when `current` started or last resumed
+        int64_t phaseNs[kPhases] = {};
+
+        static int64_t now()
+        {
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+        }
+
+        static RequestTiming& get()
+        {
+            thread_local RequestTiming timing;
+            return timing;
+        }
+    };
+
+    class PhaseTimer {
+    public:
+        explicit PhaseTimer(Phase phase)
+            : timing_(RequestTiming::get())
+        {
+            if (!timing_.on)
+                return;
+            int64_t now = RequestTiming::now();
+            if (timing_.current >= 0)
+                timing_.phaseNs[timing_.current] += now - timing_.sinceNs;
+            outer_ = timing_.current;
+            timing_.current = static_cast<int>(phase);
+            timing_.sinceNs = now;
+            active_ = true;
+        }
+
+        ~PhaseTimer()
+        {
+            if (!active_)
+                return;
+            int64_t now = RequestTiming::now();
+            timing_.phaseNs[timing_.current] += now - timing_.sinceNs;
+            timing_.current = outer_;
+            timing_.sinceNs = now;
+        }
+
+        PhaseTimer(const PhaseTimer&) = delete;
+        PhaseTimer& operator=(const PhaseTimer&) = delete;
+
+    private:
+        RequestTiming& timing_;
+        int outer_ = -1;
+        bool active_ = false;
+    };
+
+    static void beginRequestTiming()
+    {
+        auto& t = RequestTiming::get();
+        t = RequestTiming {};
+        t.on = true;
+        t.startNs = t.sinceNs = RequestTiming::now();
+    }
+
+    static void endRequestTiming()
+    {
+        RequestTiming::get().on = false;
+    }
+
+    // "Server-Timing: app;dur=0.412, serialize;dur=1.03, total;dur=1.61"
+    // (phases that took no time left out) plus Timing-Allow-Origin, so
+    // cross-origin pages can read it too; "" outside a request. Taken as the
+    // headers go out, so the body's socket write is not part of it.
+    static std::string serverTimingHeaders()
+    {
+        const auto& t = RequestTiming::get();
+        if (!t.on)
+            return {};
+        int64_t now = RequestTiming::now();
+        std::string out = "Server-Timing: ";
+        char buf[48];
+        for (size_t i = 0; i < kPhases; ++i) {
+            int64_t ns = t.phaseNs[i] + (static_cast<int>(i) == t.current ? now - t.sinceNs : 0);
+            if (ns <= 0)
+                continue;
+            int n = std::snprintf(buf, sizeof(buf), "%s;dur=%.3f, ", kPhaseNames[i], static_cast<double>(ns) / 1e6);
+            out.append(buf, static_cast<size_t>(n));
+        }
+        int n = std::snprintf(buf, sizeof(buf), "total;dur=%.3f\r\n", static_cast<double>(now - t.startNs) / 1e6);
+        out.append(buf, static_cast<size_t>(n));
+        out += "Timing-Allow-Origin: *\r\n";
+        return out;
+    }
+
     // ---------------------------------------------------------------------------
     // JSON serialization helpers
     // ---------------------------------------------------------------------------
@@ -161,201 +947,3838 @@ namespace detail {
         }
     }
 
-    static nlohmann::json perfToJson(const PerfMetrics& m)
+    static void writePerf(JsonWriter& w, const PerfMetrics& m)
     {
-        return {
-            { "fps", m.fps },
-            { "frameTimeMs", m.frameTimeMs },
-            { "entityCount", m.entityCount },
-        };
-    }
-
-    static nlohmann::json propertyToJson(const Property& p)
-    {
-        return {
-            { "name", p.name },
-            { "type", propertyTypeName(p.type) },
-            { "value", p.value },
-        };
+        w.raw("{\"fps\":");
+        w.number(m.fps);
+        w.raw(",\"frameTimeMs\":");
+        w.number(m.frameTimeMs);
+        w.raw(",\"entityCount\":");
+        w.integer(m.entityCount);
+        w.raw("}", 1);
     }
 
-    static nlohmann::json entityToJson(const EntityInfo& e)
+    static void writeEntity(JsonWriter& w, const EntityInfo& e)
     {
-        nlohmann::json props = nlohmann::json::array();
-        for (auto& p : e) {
-            props.push_back(propertyToJson(p));
+        w.raw("{\"properties\":[");
+        for (size_t i = 0; i < e.size(); ++i) {
+            const Property& p = e[i];
+            if (i > 0)
+                w.raw(",", 1);
+            w.raw("{\"name\":");
+            w.string(p.name);
+            w.raw(",\"type\":\"");
+            w.raw(propertyTypeName(p.type));
+            w.raw("\",\"value\":");
+            w.json(p.value, p.type == PropertyType::Float || p.type == PropertyType::Points2D);
+            w.raw("}", 1);
         }
-        return {
-            { "properties", props },
-        };
+        w.raw("]}", 2);
     }
 
-    // Build nested tree JSON from a flat list of SceneNodes.
-    // Nodes with parentId == 0 become roots.
-    static nlohmann::json buildSceneTree(const std::vector<SceneNode>& flat)
-    {
-        // Each node's JSON representation (without children filled yet)
-        struct TreeEntry {
-            nlohmann::json obj;
-            uintptr_t parentId;
-        };
-
-        // Preserve insertion order: use vector + map for lookup
-        std::unordered_map<uintptr_t, size_t> indexById;
-        std::vector<TreeEntry> entries;
-        entries.reserve(flat.size());
+    // ---------------------------------------------------------------------------
+    // Scene serialization with subtree fragment reuse
+    // ---------------------------------------------------------------------------
 
-        for (auto& n : flat) {
-            nlohmann::json obj = {
-                { "id", std::to_string(n.id) },
-                { "type", n.type },
-                { "name", n.name.empty() ? nlohmann::json(nullptr) : nlohmann::json(n.name) },
-                { "children", nlohmann::json::array() },
-            };
-            indexById[n.id] = entries.size();
-            entries.push_back({ std::move(obj), n.parentId });
+    // Streaming 64-bit hash over four independent lanes (xxHash64 layout).
+    // Each 32-byte stripe updates the lanes without cross-lane dependencies,
+    // so they stay in parallel (or vector) registers.
+    class StripeHasher {
+    public:
+        void update(const void* data, size_t n)
+        {
+            auto* p = static_cast<const unsigned char*>(data);
+            total_ += n;
+            if (bufLen_ > 0) {
+                size_t take = std::min(n, sizeof(buf_) - bufLen_);
+                std::memcpy(buf_ + bufLen_, p, take);
+                bufLen_ += take;
+                p += take;
+                n -= take;
+                if (bufLen_ < sizeof(buf_))
+                    return;
+                stripe(buf_);
+                bufLen_ = 0;
+            }
+            for (; n >= sizeof(buf_); p += sizeof(buf_), n -= sizeof(buf_))
+                stripe(p);
+            std::memcpy(buf_, p, n);
+            bufLen_ = n;
         }
 
-        // Attach children to parents (iterate in reverse so deeper nodes are
-        // attached before their parents get serialized).
-        // We'll collect root indices.
-        std::vector<size_t> rootIndices;
-        for (size_t i = 0; i < entries.size(); ++i) {
-            if (entries[i].parentId == 0) {
-                rootIndices.push_back(i);
-            }
+        template <typename T>
+        void value(const T& v) { update(&v, sizeof(v)); }
+
+        // Length-prefixed so adjacent strings can't alias
+        void string(const std::string& s)
+        {
+            value(static_cast<uint64_t>(s.size()));
+            update(s.data(), s.size());
         }
 
-        // Build children bottom-up: iterate all nodes, attach to parent
-        // We need a proper approach: collect children lists, then recursively build.
-        std::unordered_map<uintptr_t, std::vector<size_t>> childrenOf;
-        for (size_t i = 0; i < entries.size(); ++i) {
-            if (entries[i].parentId != 0) {
-                childrenOf[entries[i].parentId].push_back(i);
+        uint64_t digest() const
+        {
+            uint64_t h;
+            if (total_ >= sizeof(buf_)) {
+                h = rotl(lanes_[0], 1) + rotl(lanes_[1], 7) + rotl(lanes_[2], 12) + rotl(lanes_[3], 18);
+                for (uint64_t lane : lanes_)
+                    h = (h ^ round(0, lane)) * kP1 + kP4;
+            } else {
+                h = kP5;
             }
-        }
+            h += total_;
 
-        // Recursive build
-        std::function<nlohmann::json(size_t)> build = [&](size_t idx) -> nlohmann::json {
-            auto& e = entries[idx];
-            nlohmann::json node = std::move(e.obj);
-            auto it = childrenOf.find(flat[idx].id);
-            if (it != childrenOf.end()) {
-                for (size_t ci : it->second) {
-                    node["children"].push_back(build(ci));
-                }
+            const unsigned char* p = buf_;
+            size_t n = bufLen_;
+            for (; n >= 8; p += 8, n -= 8) {
+                uint64_t v;
+                std::memcpy(&v, p, 8);
+                h = rotl(h ^ round(0, v), 27) * kP1 + kP4;
             }
-            return node;
-        };
+            for (; n > 0; ++p, --n)
+                h = rotl(h ^ (*p * kP5), 11) * kP1;
 
-        nlohmann::json roots = nlohmann::json::array();
-        for (size_t ri : rootIndices) {
-            roots.push_back(build(ri));
+            h ^= h >> 33;
+            h *= kP2;
+            h ^= h >> 29;
+            h *= kP3;
+            h ^= h >> 32;
+            return h;
         }
 
-        return { { "entities", roots } };
-    }
-
-    // ---------------------------------------------------------------------------
-    // HTTP helpers
-    // ---------------------------------------------------------------------------
+    private:
+        static constexpr uint64_t kP1 = 11400714785074694791ull;
+        static constexpr uint64_t kP2 = 14029467366897019727ull;
+        static constexpr uint64_t kP3 = 1609587929392839161ull;
+        static constexpr uint64_t kP4 = 9650029242287828579ull;
+        static constexpr uint64_t kP5 = 2870177450012600261ull;
 
-    static void sendJson(struct mg_connection* conn, int status, const nlohmann::json& j)
-    {
-        std::string body = j.dump();
-        mg_printf(conn,
-            "HTTP/1.1 %d %s\r\n"
-            "Content-Type: application/json\r\n"
-            "Access-Control-Allow-Origin: *\r\n"
-            "Content-Length: %zu\r\n"
-            "Connection: keep-alive\r\n"
-            "\r\n",
-            status, (status == 200 ? "OK" : "Not Found"),
-            body.size());
-        mg_write(conn, body.data(), body.size());
-    }
+        static uint64_t rotl(uint64_t x, int r) { return (x << r) | (x >> (64 - r)); }
 
-    static void sendCorsOptions(struct mg_connection* conn)
-    {
-        mg_printf(conn,
-            "HTTP/1.1 204 No Content\r\n"
-            "Access-Control-Allow-Origin: *\r\n"
-            "Access-Control-Allow-Methods: GET, OPTIONS\r\n"
-            "Access-Control-Allow-Headers: Content-Type\r\n"
-            "Content-Length: 0\r\n"
-            "\r\n");
-    }
+        static uint64_t round(uint64_t acc, uint64_t input)
+        {
+            return rotl(acc + input * kP2, 31) * kP1;
+        }
 
-    // ---------------------------------------------------------------------------
-    // CivetWeb request handlers (C callbacks)
-    // ---------------------------------------------------------------------------
+        void stripe(const unsigned char* p)
+        {
+            uint64_t v[4];
+            std::memcpy(v, p, sizeof(v));
+            for (int i = 0; i < 4; ++i)
+                lanes_[i] = round(lanes_[i], v[i]);
+        }
 
-    // Friend accessor: bridges C callbacks to protected virtual methods
-    struct ServerAccess {
-        static PerfMetrics getPerf(Server* s) { return s->onGetPerf(); }
-        static std::vector<SceneNode> getScene(Server* s) { return s->onGetScene(); }
-        static std::optional<EntityInfo> getEntity(Server* s, uintptr_t id) { return s->onGetEntity(id); }
+        uint64_t lanes_[4] = { kP1 + kP2, kP2, 0, 0 - kP1 };
+        unsigned char buf_[32] = {};
+        size_t bufLen_ = 0;
+        uint64_t total_ = 0;
     };
 
-    static int handlePerf(struct mg_connection* conn, void* cbdata)
+    // Content hash of the flat scene as the app returned it
+    static uint64_t hashScene(const std::vector<SceneNode>& flat)
     {
-        auto* req = mg_get_request_info(conn);
-        if (std::strcmp(req->request_method, "OPTIONS") == 0) {
-            sendCorsOptions(conn);
-            return 204;
+        StripeHasher h;
+        h.value(static_cast<uint64_t>(flat.size()));
+        for (auto& n : flat) {
+            h.value(static_cast<uint64_t>(n.id));
+            h.value(static_cast<uint64_t>(n.parentId));
+            h.string(n.type);
+            h.string(n.name);
         }
-        auto* server = static_cast<Server*>(cbdata);
-        auto metrics = ServerAccess::getPerf(server);
-        sendJson(conn, 200, perfToJson(metrics));
-        return 200;
+        return h.digest();
     }
 
-    static int handleScene(struct mg_connection* conn, void* cbdata)
+    // 64-bit FNV-1a, continued from `h`
+    static uint64_t hashBytes(uint64_t h, const void* data, size_t n)
     {
-        auto* req = mg_get_request_info(conn);
-        if (std::strcmp(req->request_method, "OPTIONS") == 0) {
-            sendCorsOptions(conn);
-            return 204;
+        auto* p = static_cast<const unsigned char*>(data);
+        for (size_t i = 0; i < n; ++i) {
+            h ^= p[i];
+            h *= 0x100000001b3ull;
         }
-        auto* server = static_cast<Server*>(cbdata);
-        auto nodes = ServerAccess::getScene(server);
-        sendJson(conn, 200, buildSceneTree(nodes));
-        return 200;
+        return h;
     }
 
-    static int handleEntity(struct mg_connection* conn, void* cbdata)
+    static uint64_t hashMix(uint64_t h, uint64_t v)
     {
-        auto* req = mg_get_request_info(conn);
-        if (std::strcmp(req->request_method, "OPTIONS") == 0) {
-            sendCorsOptions(conn);
-            return 204;
-        }
+        return hashBytes(h, &v, sizeof(v));
+    }
 
-        // Parse entity ID from URI: /api/entity/<id>
-        const char* uri = req->local_uri;
-        const char* idStr = std::strrchr(uri, '/');
-        if (!idStr || *(idStr + 1) == '\0') {
-            sendJson(conn, 404, { { "error", "Missing entity ID" } });
-            return 404;
-        }
-        idStr++; // skip '/'
+    // The flat node list as a forest: nodes with parentId == 0 are roots,
+    // nodes whose parent is missing are dropped. Children keep input order.
+    struct SceneForest {
+        static constexpr size_t kNone = static_cast<size_t>(-1);
 
+        std::vector<size_t> roots;
+        std::vector<size_t> parentOf; // kNone for roots and dropped nodes
+        std::vector<size_t> childStart; // children of i: children[childStart[i], childStart[i + 1])
+        std::vector<size_t> children;
+        std::vector<size_t> order; // pre-order over the nodes reachable from the roots
+        bool uniqueIds = true; // false if an id appears twice (children go to its last node)
+
+        explicit SceneForest(const std::vector<SceneNode>& flat)
+        {
+            const size_t n = flat.size();
+
+            // Preserve insertion order: vector + map for lookup
+            std::unordered_map<uintptr_t, size_t> indexById;
+            indexById.reserve(n);
+            for (size_t i = 0; i < n; ++i) {
+                auto [it, inserted] = indexById.try_emplace(flat[i].id, i);
+                if (!inserted) {
+                    it->second = i;
+                    uniqueIds = false;
+                }
+            }
+
+            // Children of each node in input order, CSR layout
+            parentOf.assign(n, kNone);
+            childStart.assign(n + 1, 0);
+            for (size_t i = 0; i < n; ++i) {
+                if (flat[i].parentId == 0) {
+                    roots.push_back(i);
+                    continue;
+                }
+                auto it = indexById.find(flat[i].parentId);
+                if (it != indexById.end()) {
+                    parentOf[i] = it->second;
+                    ++childStart[it->second + 1];
+                }
+            }
+            for (size_t i = 0; i < n; ++i)
+                childStart[i + 1] += childStart[i];
+            children.resize(childStart[n]);
+            std::vector<size_t> fill(childStart.begin(), childStart.end() - 1);
+            for (size_t i = 0; i < n; ++i) {
+                if (parentOf[i] != kNone)
+                    children[fill[parentOf[i]]++] = i;
+            }
+
+            order.reserve(n);
+            std::vector<size_t> stack(roots.rbegin(), roots.rend());
+            while (!stack.empty()) {
+                size_t i = stack.back();
+                stack.pop_back();
+                order.push_back(i);
+                for (size_t c = childStart[i + 1]; c > childStart[i]; --c)
+                    stack.push_back(children[c - 1]);
+            }
+        }
+    };
+
+    // Builds the /api/scene body from the flat node list (see SceneForest
+    // for roots and orphans).
+    //
+    // Every subtree gets a structural hash over ids, types, names and child
+    // order. A subtree whose hash matches the previous call is copied verbatim
+    // from the previous body, which saves formatting and escaping the nodes
+    // that didn't change; building the forest and hashing still visit every
+    // node. Fragments are looked up by id, so a node list with duplicate ids
+    // is written in full and leaves nothing to splice from. Not thread-safe:
+    // callers serialize access.
+    class SceneSerializer {
+    public:
+        std::shared_ptr<const std::string> serialize(const std::vector<SceneNode>& flat)
+        {
+            const size_t n = flat.size();
+            std::optional<PhaseTimer> timer(std::in_place, Phase::Build);
+            SceneForest forest(flat);
+            const auto& roots = forest.roots;
+            const auto& parentOf = forest.parentOf;
+            const auto& childStart = forest.childStart;
+            const auto& children = forest.children;
+            const auto& order = forest.order;
+
+            // Hash bottom-up
+            std::vector<uint64_t> hash(n, 0);
+            for (auto it = order.rbegin(); it != order.rend(); ++it) {
+                const SceneNode& node = flat[*it];
+                uint64_t h = hashMix(0xcbf29ce484222325ull, node.id);
+                h = hashBytes(hashMix(h, node.type.size()), node.type.data(), node.type.size());
+                h = hashBytes(hashMix(h, node.name.size()), node.name.data(), node.name.size());
+                h = hashMix(h, childStart[*it + 1] - childStart[*it]);
+                for (size_t c = childStart[*it]; c < childStart[*it + 1]; ++c)
+                    h = hashMix(h, hash[children[c]]);
+                hash[*it] = h;
+            }
+
+            // Emit, splicing unchanged subtrees from the previous body
+            timer.reset();
+            PhaseTimer emitting(Phase::Serialize);
+            if (!forest.uniqueIds)
+                prev_.clear();
+            static const std::string kEmpty;
+            const std::string& prevBody = prevBody_ ? *prevBody_ : kEmpty;
+            std::string body;
+            body.reserve(prevBody.size() + 64);
+            JsonWriter w(body);
+            std::vector<size_t> offset(n, 0);
+            std::vector<size_t> length(n, 0);
+            std::vector<bool> reused(n, false);
+
+            auto open = [&](size_t i) -> bool {
+                const SceneNode& node = flat[i];
+                offset[i] = body.size();
+                auto prev = prev_.find(node.id);
+                if (prev != prev_.end() && prev->second.hash == hash[i]) {
+                    body.append(prevBody, prev->second.offset, prev->second.length);
+                    length[i] = prev->second.length;
+                    reused[i] = true;
+                    return false;
+                }
+                w.raw("{\"id\":\"");
+                w.uint(node.id);
+                w.raw("\",\"type\":");
+                w.string(node.type);
+                w.raw(",\"name\":");
+                if (node.name.empty())
+                    w.raw("null");
+                else
+                    w.string(node.name);
+                w.raw(",\"children\":[");
+                return true;
+            };
+
+            w.raw("{\"entities\":[");
+            struct Cursor {
+                size_t node;
+                size_t next;
+            };
+            std::vector<Cursor> path;
+            for (size_t r = 0; r < roots.size(); ++r) {
+                if (r > 0)
+                    w.raw(",", 1);
+                if (open(roots[r]))
+                    path.push_back({ roots[r], childStart[roots[r]] });
+                while (!path.empty()) {
+                    Cursor& top = path.back();
+                    if (top.next == childStart[top.node + 1]) {
+                        w.raw("]}", 2);
+                        length[top.node] = body.size() - offset[top.node];
+                        path.pop_back();
+                        continue;
+                    }
+                    if (top.next > childStart[top.node])
+                        w.raw(",", 1);
+                    size_t child = children[top.next++];
+                    if (open(child))
+                        path.push_back({ child, childStart[child] });
+                }
+            }
+            w.raw("]}", 2);
+
+            // Fragments for the next call. Nodes inside a reused subtree kept
+            // their bytes, so only their offset moves with the subtree root.
+            std::unordered_map<uintptr_t, Fragment> next;
+            next.reserve(order.size());
+            for (size_t i : order) {
+                if (!forest.uniqueIds)
+                    break;
+                size_t p = parentOf[i];
+                if (p != SceneForest::kNone && reused[p]) {
+                    auto prev = prev_.find(flat[i].id);
+                    auto prevParent = prev_.find(flat[p].id);
+                    reused[i] = true;
+                    if (prev == prev_.end() || prevParent == prev_.end())
+                        continue; // hash collision: forget this fragment
+                    offset[i] = offset[p] + (prev->second.offset - prevParent->second.offset);
+                    length[i] = prev->second.length;
+                }
+                next[flat[i].id] = { hash[i], offset[i], length[i] };
+            }
+
+            prev_ = std::move(next);
+            prevBody_ = std::make_shared<const std::string>(std::move(body));
+            return prevBody_;
+        }
+
+    private:
+        struct Fragment {
+            uint64_t hash;
+            size_t offset;
+            size_t length;
+        };
+
+        std::shared_ptr<const std::string> prevBody_;
+        std::unordered_map<uintptr_t, Fragment> prev_;
+    };
+
+    // ---------------------------------------------------------------------------
+    // Merkle tree over the scene (/api/merkle): lets two instances of one
+    // simulation narrow down where they diverge, one level per round trip
+    // ---------------------------------------------------------------------------
+
+    // Subtree hashes over node types, names, child order and the bytes of
+    // each entity's properties, but not ids: ids are often pointers, which
+    // differ between processes, so nodes are addressed by child-index path.
+    // build() starts over from a fresh node list: there is no dirty-path
+    // update, since nothing but a version says which entities changed. It
+    // hashes every node, and keeps entity hashes per id and version, so
+    // only entities without onGetEntityVersion, or whose version moved, are
+    // fetched and re-serialized. Not thread-safe: callers serialize access.
+    class MerkleTree {
+    public:
+        static constexpr size_t kRoot = SceneForest::kNone;
+
+        // `version(id)` and `entity(id)` are the source's
+        // onGetEntityVersion/onGetEntity
+        template <typename Version, typename Entity>
+        void build(std::vector<SceneNode> flat, Version&& version, Entity&& entity)
+        {
+            flat_ = std::move(flat);
+            forest_ = SceneForest(flat_);
+            const size_t n = flat_.size();
+
+            std::unordered_map<uintptr_t, EntityHash> entities;
+            entities.reserve(forest_.order.size());
+            entity_.assign(n, 0);
+            std::string buf;
+            for (size_t i : forest_.order) {
+                uintptr_t id = flat_[i].id;
+                std::optional<uint64_t> v = version(id);
+                auto prev = entities_.find(id);
+                if (v && prev != entities_.end() && prev->second.version == v) {
+                    entity_[i] = prev->second.hash;
+                } else if (std::optional<EntityInfo> info = entity(id)) {
+                    buf.clear();
+                    JsonWriter w(buf);
+                    writeEntity(w, *info);
+                    StripeHasher h;
+                    h.update(buf.data(), buf.size());
+                    entity_[i] = h.digest();
+                }
+                entities[id] = { v, entity_[i] };
+            }
+            entities_ = std::move(entities);
+
+            hash_.assign(n, 0);
+            size_.assign(n, 1);
+            for (auto it = forest_.order.rbegin(); it != forest_.order.rend(); ++it) {
+                size_t i = *it;
+                const SceneNode& node = flat_[i];
+                uint64_t h = 0xcbf29ce484222325ull;
+                h = hashBytes(hashMix(h, node.type.size()), node.type.data(), node.type.size());
+                h = hashBytes(hashMix(h, node.name.size()), node.name.data(), node.name.size());
+                h = hashMix(h, entity_[i]);
+                h = hashMix(h, forest_.childStart[i + 1] - forest_.childStart[i]);
+                for (size_t c = forest_.childStart[i]; c < forest_.childStart[i + 1]; ++c) {
+                    h = hashMix(h, hash_[forest_.children[c]]);
+                    size_[i] += size_[forest_.children[c]];
+                }
+                hash_[i] = h;
+            }
+
+            rootHash_ = hashMix(0xcbf29ce484222325ull, forest_.roots.size());
+            for (size_t r : forest_.roots)
+                rootHash_ = hashMix(rootHash_, hash_[r]);
+        }
+
+        // Node at a child-index path such as "0/3/1" ("" is the scene root,
+        // whose children are the scene's roots); nullopt if there is none
+        std::optional<size_t> find(const std::string& path) const
+        {
+            size_t node = kRoot;
+            const char* p = path.data();
+            const char* end = p + path.size();
+            while (p < end) {
+                size_t index = 0;
+                auto [next, ec] = std::from_chars(p, end, index);
+                if (ec != std::errc {} || (next < end && *next != '/'))
+                    return std::nullopt;
+                const size_t* first = childrenOf(node);
+                if (index >= childCount(node))
+                    return std::nullopt;
+                node = first[index];
+                p = next < end ? next + 1 : end;
+            }
+            return node;
+        }
+
+        // {"path","frame","hash","size",("id","type","name","entity",)"children":[...]}
+        void write(JsonWriter& w, const std::string& path, size_t node, uint64_t frame) const
+        {
+            w.raw("{\"path\":");
+            w.string(path);
+            w.raw(",\"frame\":");
+            w.uint(frame);
+            writeSummary(w, node);
+            w.raw(",\"children\":[");
+            const size_t* first = childrenOf(node);
+            for (size_t c = 0; c < childCount(node); ++c) {
+                w.raw(c == 0 ? "{" : ",{", c == 0 ? 1 : 2);
+                w.raw("\"index\":");
+                w.uint(c);
+                writeSummary(w, first[c]);
+                w.raw("}", 1);
+            }
+            w.raw("]}", 2);
+        }
+
+    private:
+        struct EntityHash {
+            std::optional<uint64_t> version;
+            uint64_t hash;
+        };
+
+        const size_t* childrenOf(size_t node) const
+        {
+            return node == kRoot ? forest_.roots.data() : forest_.children.data() + forest_.childStart[node];
+        }
+
+        size_t childCount(size_t node) const
+        {
+            return node == kRoot ? forest_.roots.size() : forest_.childStart[node + 1] - forest_.childStart[node];
+        }
+
+        static void writeHash(JsonWriter& w, uint64_t h)
+        {
+            char hex[19];
+            std::snprintf(hex, sizeof(hex), "\"%016llx\"", static_cast<unsigned long long>(h));
+            w.raw(hex, 18);
+        }
+
+        void writeSummary(JsonWriter& w, size_t node) const
+        {
+            w.raw(",\"hash\":");
+            writeHash(w, node == kRoot ? rootHash_ : hash_[node]);
+            w.raw(",\"size\":");
+            w.uint(node == kRoot ? forest_.order.size() : size_[node]);
+            if (node == kRoot)
+                return;
+            const SceneNode& n = flat_[node];
+            w.raw(",\"id\":\"");
+            w.uint(n.id);
+            w.raw("\",\"type\":");
+            w.string(n.type);
+            w.raw(",\"name\":");
+            if (n.name.empty())
+                w.raw("null");
+            else
+                w.string(n.name);
+            w.raw(",\"entity\":");
+            writeHash(w, entity_[node]);
+        }
+
+        std::vector<SceneNode> flat_;
+        SceneForest forest_ { {} };
+        std::vector<uint64_t> entity_; // 0 if the entity has no properties to give
+        std::vector<uint64_t> hash_;
+        std::vector<size_t> size_; // nodes in the subtree
+        uint64_t rootHash_ = 0;
+        std::unordered_map<uintptr_t, EntityHash> entities_;
+    };
+
+    // ---------------------------------------------------------------------------
+    // Frame pacing (fed by Server::recordFrame, served at /api/perf/pacing)
+    // ---------------------------------------------------------------------------
+
+    // Stutter metrics over a sliding window of frames, plus lifetime totals.
+    // Every statistic is maintained incrementally: a frame costs O(1) to add,
+    // including the window median, which is tracked as a position in a
+    // histogram that moves by a bin or two per frame.
+    //
+    // A hitch is a frame longer than twice the window median (once the window
+    // has kMinFrames); missed slots are the extra display refreshes a frame
+    // spanned at the target rate; a bad frame is a hitch or a frame that
+    // missed a slot.
+    class FramePacing {
+    public:
+        static constexpr size_t kWindow = 1024;
+        static constexpr size_t kMinFrames = 16;
+        static constexpr int kBins = 2000; // 0.1 ms each; the last is open-ended
+        static constexpr float kBinsPerMs = 10.0f;
+
+        void setTargetRate(float hz)
+        {
+            targetHz_ = std::max(hz, 0.0f);
+            slotMs_ = hz > 0.0f ? 1000.0f / hz : 0.0f;
+        }
+
+        void add(float frameTimeMs)
+        {
+            Frame f;
+            f.ms = frameTimeMs;
+            f.delta = total_.frames > 0 ? frameTimeMs - lastMs_ : 0.0f;
+            f.hitch = count_ >= kMinFrames && frameTimeMs > 2.0f * medianMs();
+            f.missed = slotMs_ > 0.0f ? missedSlots(frameTimeMs) : 0;
+            lastMs_ = frameTimeMs;
+
+            if (count_ == kWindow)
+                remove(frames_[head_]);
+            else
+                ++count_;
+            frames_[head_] = f;
+            head_ = (head_ + 1) % kWindow;
+            insert(f);
+
+            bool bad = f.hitch || f.missed > 0;
+            ++total_.frames;
+            total_.hitches += f.hitch;
+            total_.missedSlots += f.missed;
+            streak_ = bad ? streak_ + 1 : 0;
+            total_.longestBadStreak = std::max(total_.longestBadStreak, streak_);
+
+            // Re-derive the running sums now and then so float error cannot
+            // accumulate over a long session
+            if (++sinceResum_ == kWindow)
+                resum();
+        }
+
+        void write(JsonWriter& w) const
+        {
+            double n = static_cast<double>(count_);
+            double mean = count_ ? sumMs_ / n : 0.0;
+            // Frame-to-frame deltas; the window's oldest delta points outside it
+            // but is kept for simplicity
+            double deltaMean = count_ ? sumDelta_ / n : 0.0;
+            double variance = count_ ? std::max(0.0, sumDelta2_ / n - deltaMean * deltaMean) : 0.0;
+
+            w.raw("{\"window\":");
+            w.uint(count_);
+            w.raw(",\"targetHz\":");
+            w.number(targetHz_);
+            w.raw(",\"meanMs\":");
+            w.number(static_cast<float>(mean));
+            w.raw(",\"medianMs\":");
+            w.number(count_ ? medianMs() : 0.0f);
+            w.raw(",\"frameToFrameVariance\":");
+            w.number(static_cast<float>(variance));
+            w.raw(",\"frameToFrameStdDevMs\":");
+            w.number(static_cast<float>(std::sqrt(variance)));
+            w.raw(",\"hitches\":");
+            w.uint(hitches_);
+            w.raw(",\"missedSlots\":");
+            w.uint(missedSlots_);
+            w.raw(",\"badFrames\":");
+            w.uint(badFrames_);
+            w.raw(",\"currentBadStreak\":");
+            w.uint(streak_);
+            w.raw(",\"total\":{\"frames\":");
+            w.uint(total_.frames);
+            w.raw(",\"hitches\":");
+            w.uint(total_.hitches);
+            w.raw(",\"missedSlots\":");
+            w.uint(total_.missedSlots);
+            w.raw(",\"longestBadStreak\":");
+            w.uint(total_.longestBadStreak);
+            w.raw("}}", 2);
+        }
+
+    private:
+        struct Frame {
+            float ms;
+            float delta;
+            uint32_t missed;
+            bool hitch;
+        };
+
+        struct Totals {
+            uint64_t frames = 0;
+            uint64_t hitches = 0;
+            uint64_t missedSlots = 0;
+            uint64_t longestBadStreak = 0;
+        };
+
+        static int binOf(float ms)
+        {
+            float b = ms * kBinsPerMs;
+            return b <= 0.0f ? 0 : b >= kBins - 1 ? kBins - 1 : static_cast<int>(b);
+        }
+
+        uint32_t missedSlots(float ms) const
+        {
+            // Round to whole slots: a frame slightly over budget presents on
+            // the next refresh, one over 1.5 slots late missed one
+            float slots = std::floor(ms / slotMs_ + 0.5f);
+            return slots > 1.0f ? static_cast<uint32_t>(std::min(slots - 1.0f, 1e6f)) : 0;
+        }
+
+        float medianMs() const { return (static_cast<float>(median_) + 0.5f) / kBinsPerMs; }
+
+        void insert(const Frame& f)
+        {
+            int b = binOf(f.ms);
+            ++bins_[b];
+            below_ += b < median_;
+            sumMs_ += f.ms;
+            sumDelta_ += f.delta;
+            sumDelta2_ += static_cast<double>(f.delta) * f.delta;
+            hitches_ += f.hitch;
+            missedSlots_ += f.missed;
+            badFrames_ += f.hitch || f.missed > 0;
+            rebalance();
+        }
+
+        void remove(const Frame& f)
+        {
+            int b = binOf(f.ms);
+            --bins_[b];
+            below_ -= b < median_;
+            sumMs_ -= f.ms;
+            sumDelta_ -= f.delta;
+            sumDelta2_ -= static_cast<double>(f.delta) * f.delta;
+            hitches_ -= f.hitch;
+            missedSlots_ -= f.missed;
+            badFrames_ -= f.hitch || f.missed > 0;
+        }
+
+        // Moves the median bin until it holds the sample of rank (n + 1) / 2
+        void rebalance()
+        {
+            size_t rank = (count_ + 1) / 2;
+            while (median_ > 0 && below_ >= rank)
+                below_ -= bins_[--median_];
+            while (below_ + bins_[median_] < rank)
+                below_ += bins_[median_++];
+        }
+
+        void resum()
+        {
+            sinceResum_ = 0;
+            sumMs_ = sumDelta_ = sumDelta2_ = 0.0;
+            for (size_t i = 0; i < count_; ++i) {
+                sumMs_ += frames_[i].ms;
+                sumDelta_ += frames_[i].delta;
+                sumDelta2_ += static_cast<double>(frames_[i].delta) * frames_[i].delta;
+            }
+        }
+
+        Frame frames_[kWindow] = {};
+        size_t head_ = 0;
+        size_t count_ = 0;
+        size_t sinceResum_ = 0;
+        float lastMs_ = 0.0f;
+        float targetHz_ = 60.0f;
+        float slotMs_ = 1000.0f / 60.0f;
+
+        uint32_t bins_[kBins] = {};
+        int median_ = 0;
+        size_t below_ = 0; // samples in bins below median_
+
+        double sumMs_ = 0.0;
+        double sumDelta_ = 0.0;
+        double sumDelta2_ = 0.0;
+        uint64_t hitches_ = 0;
+        uint64_t missedSlots_ = 0;
+        uint64_t badFrames_ = 0;
+        uint64_t streak_ = 0;
+        Totals total_;
+    };
+
+    // ---------------------------------------------------------------------------
+    // Frame history (fed by Server::recordFrame, served at /api/perf/frames)
+    // ---------------------------------------------------------------------------
+
+    // Fixed ring of the most recent frame times. Frames are numbered from 1;
+    // a marker is stamped with the number of the frame recorded after it.
+    class FrameHistory {
+    public:
+        static constexpr size_t kCapacity = 8192;
+        static constexpr size_t kMaxMarkers = 256;
+
+        // Returns the number of the recorded frame
+        uint64_t record(float frameTimeMs)
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            samples_[count_ % kCapacity] = frameTimeMs;
+            pacing_.add(frameTimeMs);
+            return ++count_;
+        }
+
+        void setTargetRate(float hz)
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            pacing_.setTargetRate(hz);
+        }
+
+        uint64_t latest() const
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            return count_;
+        }
+
+        void writePacing(JsonWriter& w) const
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            pacing_.write(w);
+        }
+
+        void mark(const std::string& name)
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (markers_.size() >= kMaxMarkers)
+                markers_.erase(markers_.begin());
+            markers_.push_back({ count_ + 1, name });
+        }
+
+        // Frames newer than `since` that are still in the ring, written as the
+        // members of an object. Markers are only reported once the frame they
+        // are attached to has been recorded.
+        void writeSince(JsonWriter& w, uint64_t since) const
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            uint64_t oldest = count_ > kCapacity ? count_ - kCapacity + 1 : 1;
+            uint64_t first = std::max(since + 1, oldest);
+
+            w.raw("\"latest\":");
+            w.uint(count_);
+            w.raw(",\"first\":");
+            w.uint(first);
+            w.raw(",\"dropped\":");
+            w.uint(first - std::min(first, since + 1));
+
+            // At most two contiguous runs of the ring
+            w.raw(",\"frameTimeMs\":[");
+            if (first <= count_) {
+                size_t begin = (first - 1) % kCapacity;
+                size_t n = static_cast<size_t>(count_ - first + 1);
+                size_t head = std::min(n, kCapacity - begin);
+                w.numbers(samples_ + begin, head);
+                if (n > head) {
+                    w.raw(",", 1);
+                    w.numbers(samples_, n - head);
+                }
+            }
+            w.raw("],\"markers\":[");
+            bool firstMark = true;
+            for (auto& m : markers_) {
+                if (m.frame <= since || m.frame > count_)
+                    continue;
+                w.raw(firstMark ? "{\"frame\":" : ",{\"frame\":");
+                w.uint(m.frame);
+                w.raw(",\"name\":");
+                w.string(m.name);
+                w.raw("}", 1);
+                firstMark = false;
+            }
+            w.raw("]", 1);
+        }
+
+    private:
+        struct Marker {
+            uint64_t frame;
+            std::string name;
+        };
+
+        mutable std::mutex mutex_;
+        float samples_[kCapacity] = {};
+        uint64_t count_ = 0;
+        std::vector<Marker> markers_;
+        FramePacing pacing_;
+    };
+
+    // ---------------------------------------------------------------------------
+    // Named loops (fed by FrameLoop::begin/end, served at /api/loops)
+    // ---------------------------------------------------------------------------
+
+    static std::chrono::steady_clock::time_point loopClockEpoch()
+    {
+        static const auto epoch = std::chrono::steady_clock::now();
+        return epoch;
+    }
+
+    // Nanoseconds on the steady clock since the first call, shared by all
+    // loops and gauges so their timestamps can be compared
+    static int64_t loopClockNs()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - loopClockEpoch()).count();
+    }
+
+    // First record number of a single-writer ring that is safe to read once
+    // `head` records (numbered from 1) have been published. The slot after the
+    // newest record holds the oldest one, and the next publish may already be
+    // overwriting it, so that record is excluded too.
+    static uint64_t ringValidFrom(uint64_t head, size_t capacity)
+    {
+        return head >= capacity ? head - capacity + 2 : 1;
+    }
+
+    // Single-writer ring of completed [begin, end) spans. The writer publishes
+    // a span by bumping `head` (release); readers copy a range and then drop
+    // whatever the writer may have overwritten meanwhile, so neither side
+    // ever waits. The writer's release fence before its slot stores pairs
+    // with the reader's acquire fence after its slot loads: a reader that saw
+    // any part of a new record re-reads a `head` at least as new as the one
+    // published before it, which puts the record's slot outside
+    // ringValidFrom().
+    struct LoopState {
+        static constexpr size_t kCapacity = 4096;
+
+        struct Span {
+            int64_t beginNs;
+            int64_t endNs;
+        };
+
+        int64_t openNs = -1; // writer only
+        std::atomic<uint64_t> head { 0 }; // spans ever published
+        std::atomic<int64_t> begins[kCapacity] = {};
+        std::atomic<int64_t> ends[kCapacity] = {};
+
+        void publish(int64_t beginNs, int64_t endNs)
+        {
+            uint64_t h = head.load(std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+            begins[h % kCapacity].store(beginNs, std::memory_order_relaxed);
+            ends[h % kCapacity].store(endNs, std::memory_order_relaxed);
+            head.store(h + 1, std::memory_order_release);
+        }
+
+        // Spans numbered (since, latest], oldest first; spans are numbered
+        // from 1. Returns the number of the first span copied.
+        uint64_t copySince(uint64_t since, std::vector<Span>& out, uint64_t& latest) const
+        {
+            latest = head.load(std::memory_order_acquire);
+            uint64_t first = std::max<uint64_t>(since + 1, ringValidFrom(latest, kCapacity));
+            out.clear();
+            for (uint64_t n = first; n <= latest; ++n) {
+                size_t slot = (n - 1) % kCapacity;
+                out.push_back({ begins[slot].load(std::memory_order_relaxed), ends[slot].load(std::memory_order_relaxed) });
+            }
+
+            // Slots the writer reached while we copied may hold newer spans
+            std::atomic_thread_fence(std::memory_order_acquire);
+            uint64_t now = head.load(std::memory_order_relaxed);
+            uint64_t valid = ringValidFrom(now, kCapacity);
+            if (valid > first) {
+                size_t torn = static_cast<size_t>(std::min<uint64_t>(valid - first, out.size()));
+                out.erase(out.begin(), out.begin() + static_cast<std::ptrdiff_t>(torn));
+                first += torn;
+            }
+            return first;
+        }
+    };
+
+    // ---------------------------------------------------------------------------
+    // Job graphs (fed by JobGraph, served at /api/jobs)
+    // ---------------------------------------------------------------------------
+
+    // Single-writer ring of one worker's job events, published and read the
+    // same way as LoopState's spans. The event kind shares a word with the
+    // timestamp (56 bits of nanoseconds is over two years).
+    struct JobRing {
+        static constexpr size_t kCapacity = 8192;
+        static constexpr int kKindShift = 56;
+
+        enum Kind : uint64_t { Spawn = 1,
+            Depend,
+            Start,
+            Finish };
+
+        struct Event {
+            Kind kind;
+            int64_t timeNs;
+            uint64_t job;
+            uint64_t arg; // name for Spawn, prerequisite for Depend
+        };
+
+        std::atomic<uint64_t> head { 0 }; // events ever published
+        std::atomic<uint64_t> stamps[kCapacity] = {};
+        std::atomic<uint64_t> jobs[kCapacity] = {};
+        std::atomic<uint64_t> args[kCapacity] = {};
+
+        void publish(Kind kind, uint64_t job, uint64_t arg)
+        {
+            uint64_t stamp = static_cast<uint64_t>(kind) << kKindShift | static_cast<uint64_t>(loopClockNs());
+            uint64_t h = head.load(std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+            stamps[h % kCapacity].store(stamp, std::memory_order_relaxed);
+            jobs[h % kCapacity].store(job, std::memory_order_relaxed);
+            args[h % kCapacity].store(arg, std::memory_order_relaxed);
+            head.store(h + 1, std::memory_order_release);
+        }
+
+        // Appends every event still in the ring, oldest first. Returns false
+        // if older events were overwritten (so anything before the first
+        // event appended may be missing).
+        bool copy(std::vector<Event>& out) const
+        {
+            uint64_t latest = head.load(std::memory_order_acquire);
+            uint64_t first = ringValidFrom(latest, kCapacity);
+            size_t start = out.size();
+            for (uint64_t n = first; n <= latest; ++n) {
+                size_t slot = (n - 1) % kCapacity;
+                uint64_t stamp = stamps[slot].load(std::memory_order_relaxed);
+                out.push_back({ static_cast<Kind>(stamp >> kKindShift),
+                    static_cast<int64_t>(stamp & ((uint64_t(1) << kKindShift) - 1)),
+                    jobs[slot].load(std::memory_order_relaxed), args[slot].load(std::memory_order_relaxed) });
+            }
+
+            std::atomic_thread_fence(std::memory_order_acquire);
+            uint64_t now = head.load(std::memory_order_relaxed);
+            uint64_t valid = ringValidFrom(now, kCapacity);
+            if (valid > first) {
+                size_t torn = static_cast<size_t>(std::min<uint64_t>(valid - first, out.size() - start));
+                out.erase(out.begin() + static_cast<std::ptrdiff_t>(start), out.begin() + static_cast<std::ptrdiff_t>(start + torn));
+            }
+            return valid == 1;
+        }
+    };
+
+    // Frames are spans on a LoopState ring, numbered from 1 like a loop's
+    // iterations; events are matched to a frame by time
+    struct JobGraphState {
+        explicit JobGraphState(int workers)
+            : rings(new JobRing[static_cast<size_t>(workers)])
+        {
+        }
+
+        LoopState frames;
+        std::unique_ptr<JobRing[]> rings;
+    };
+
+    // ---------------------------------------------------------------------------
+    // Gauges (sampled on a timer by Server's sampler thread, served at
+    // /api/gauges)
+    // ---------------------------------------------------------------------------
+
+    // One gauge's callback and its ring of timestamped samples. The ring has
+    // a single writer (the sampler thread) and is published and read the same
+    // way as LoopState's spans.
+    struct GaugeState {
+        static constexpr size_t kCapacity = 4096;
+
+        struct Sample {
+            int64_t timeNs;
+            double value;
+        };
+
+        std::string name;
+        std::function<double()> sample;
+        float rateHz = 0.0f;
+        int64_t periodNs = 0;
+        int64_t dueNs = 0; // sampler only
+        std::atomic<uint64_t> skipped { 0 }; // due times passed over while the sampler ran late
+        std::atomic<uint64_t> head { 0 }; // samples ever published
+        std::atomic<int64_t> times[kCapacity] = {};
+        std::atomic<double> values[kCapacity] = {};
+
+        void publish(int64_t timeNs, double value)
+        {
+            uint64_t h = head.load(std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+            times[h % kCapacity].store(timeNs, std::memory_order_relaxed);
+            values[h % kCapacity].store(value, std::memory_order_relaxed);
+            head.store(h + 1, std::memory_order_release);
+        }
+
+        // Samples numbered (since, latest], oldest first, numbered from 1.
+        // Returns the number of the first sample copied.
+        uint64_t copySince(uint64_t since, std::vector<Sample>& out, uint64_t& latest) const
+        {
+            latest = head.load(std::memory_order_acquire);
+            uint64_t first = std::max<uint64_t>(since + 1, ringValidFrom(latest, kCapacity));
+            out.clear();
+            for (uint64_t n = first; n <= latest; ++n) {
+                size_t slot = (n - 1) % kCapacity;
+                out.push_back({ times[slot].load(std::memory_order_relaxed), values[slot].load(std::memory_order_relaxed) });
+            }
+
+            std::atomic_thread_fence(std::memory_order_acquire);
+            uint64_t now = head.load(std::memory_order_relaxed);
+            uint64_t valid = ringValidFrom(now, kCapacity);
+            if (valid > first) {
+                size_t torn = static_cast<size_t>(std::min<uint64_t>(valid - first, out.size()));
+                out.erase(out.begin(), out.begin() + static_cast<std::ptrdiff_t>(torn));
+                first += torn;
+            }
+            return first;
+        }
+    };
+
+    // Calls every gauge on its own schedule from one thread, started by the
+    // first gauge. Between samples the thread sleeps on a timerfd armed
+    // (absolute, CLOCK_MONOTONIC) for the earliest due gauge, so samples land
+    // within the kernel's timer slack of their slot; elsewhere, or if the
+    // timerfd can't be created, it waits on a condition variable instead.
+    // A gauge that falls a whole period behind skips the missed slots rather
+    // than bursting to catch up, which keeps the series evenly spaced.
+    // Gauges are called without the list lock held, so a callback may add or
+    // remove gauges (itself included), but must not stop the server.
+    class GaugeSampler {
+    public:
+        ~GaugeSampler() { stop(); }
+
+        void add(std::shared_ptr<GaugeState> gauge)
+        {
+            {
+                std::unique_lock<std::shared_mutex> lock(mutex_);
+                gauge->dueNs = loopClockNs();
+                auto it = std::find_if(gauges_.begin(), gauges_.end(), [&](auto& g) { return g->name == gauge->name; });
+                if (it != gauges_.end())
+                    *it = std::move(gauge);
+                else
+                    gauges_.push_back(std::move(gauge));
+                if (!paused_ && !thread_.joinable())
+                    launch();
+            }
+            wake();
+        }
+
+        // Waits for a sampling pass in progress, which may still call the
+        // gauge, unless called from a gauge in that pass
+        void remove(const std::string& name)
+        {
+            {
+                std::unique_lock<std::shared_mutex> lock(mutex_);
+                gauges_.erase(std::remove_if(gauges_.begin(), gauges_.end(), [&](auto& g) { return g->name == name; }), gauges_.end());
+            }
+            if (running() != this) {
+                std::lock_guard<std::mutex> pass(passMutex_);
+            }
+        }
+
+        std::vector<std::shared_ptr<GaugeState>> list()
+        {
+            std::shared_lock<std::shared_mutex> lock(mutex_);
+            return gauges_;
+        }
+
+        // Joins the thread: no callback is running once this returns, and
+        // none is called (even for gauges added meanwhile) until resume()
+        void stop()
+        {
+            {
+                std::unique_lock<std::shared_mutex> lock(mutex_);
+                paused_ = true;
+                if (!thread_.joinable())
+                    return;
+            }
+            stopping_.store(true, std::memory_order_release);
+            wake();
+            thread_.join();
+            stopping_.store(false, std::memory_order_relaxed);
+#if defined(__linux__)
+            // Under the lock wake() reads wakeFd_ with, so it never writes to
+            // a descriptor that was closed (and maybe reused) meanwhile
+            std::lock_guard<std::mutex> lock(waitMutex_);
+            if (timerFd_ >= 0)
+                close(timerFd_);
+            if (wakeFd_ >= 0)
+                close(wakeFd_);
+            timerFd_ = wakeFd_ = -1;
+#endif
+        }
+
+        void resume()
+        {
+            std::unique_lock<std::shared_mutex> lock(mutex_);
+            paused_ = false;
+            if (!gauges_.empty() && !thread_.joinable()) {
+                for (auto& g : gauges_)
+                    g->dueNs = loopClockNs();
+                launch();
+            }
+        }
+
+    private:
+        void launch()
+        {
+#if defined(__linux__)
+            std::lock_guard<std::mutex> lock(waitMutex_);
+            timerFd_ = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+            wakeFd_ = eventfd(0, EFD_CLOEXEC);
+            if (timerFd_ < 0 || wakeFd_ < 0) {
+                std::fprintf(stderr, "[reflector] Gauge timerfd unavailable (%s), sampling on a condition variable\n", std::strerror(errno));
+                if (timerFd_ >= 0)
+                    close(timerFd_);
+                if (wakeFd_ >= 0)
+                    close(wakeFd_);
+                timerFd_ = wakeFd_ = -1;
+            }
+#endif
+            thread_ = std::thread([this] { run(); });
+        }
+
+        // The sampler whose thread this is, if any
+        static const GaugeSampler*& running()
+        {
+            thread_local const GaugeSampler* sampler = nullptr;
+            return sampler;
+        }
+
+        void run()
+        {
+            running() = this;
+            std::vector<std::shared_ptr<GaugeState>> pass;
+            while (!stopping_.load(std::memory_order_acquire)) {
+                int64_t due = INT64_MAX;
+                {
+                    // Copied under passMutex_, so a gauge removed before the
+                    // copy isn't called and remove() waits out one after it
+                    std::lock_guard<std::mutex> passing(passMutex_);
+                    {
+                        std::shared_lock<std::shared_mutex> lock(mutex_);
+                        pass = gauges_;
+                    }
+                    for (auto& g : pass) {
+                        int64_t now = loopClockNs();
+                        if (g->dueNs <= now) {
+                            g->publish(now, g->sample());
+                            g->dueNs += g->periodNs;
+                            if (g->dueNs <= now) {
+                                int64_t missed = (now - g->dueNs) / g->periodNs + 1;
+                                g->skipped.fetch_add(static_cast<uint64_t>(missed), std::memory_order_relaxed);
+                                g->dueNs += missed * g->periodNs;
+                            }
+                        }
+                        due = std::min(due, g->dueNs);
+                    }
+                    pass.clear();
+                }
+                wait(due);
+            }
+        }
+
+        void wait(int64_t due)
+        {
+#if defined(__linux__)
+            if (timerFd_ >= 0) {
+                // libstdc++ and libc++ implement steady_clock on CLOCK_MONOTONIC
+                itimerspec spec = {};
+                if (due != INT64_MAX) {
+                    int64_t at = std::chrono::duration_cast<std::chrono::nanoseconds>(loopClockEpoch().time_since_epoch()).count() + due;
+                    spec.it_value.tv_sec = static_cast<time_t>(at / 1000000000);
+                    spec.it_value.tv_nsec = static_cast<long>(at % 1000000000);
+                }
+                timerfd_settime(timerFd_, TFD_TIMER_ABSTIME, &spec, nullptr);
+
+                pollfd fds[2] = { { timerFd_, POLLIN, 0 }, { wakeFd_, POLLIN, 0 } };
+                if (poll(fds, 2, -1) > 0) {
+                    uint64_t count;
+                    if (fds[0].revents & POLLIN)
+                        (void)!read(timerFd_, &count, sizeof(count));
+                    if (fds[1].revents & POLLIN)
+                        (void)!read(wakeFd_, &count, sizeof(count));
+                }
+                return;
+            }
+#endif
+            std::unique_lock<std::mutex> lock(waitMutex_);
+            auto woken = [this] { return woken_; };
+            if (due == INT64_MAX)
+                cv_.wait(lock, woken);
+            else
+                cv_.wait_until(lock, loopClockEpoch() + std::chrono::nanoseconds(due), woken);
+            woken_ = false;
+        }
+
+        void wake()
+        {
+            std::lock_guard<std::mutex> lock(waitMutex_);
+#if defined(__linux__)
+            if (wakeFd_ >= 0) {
+                uint64_t one = 1;
+                (void)!write(wakeFd_, &one, sizeof(one));
+                return;
+            }
+#endif
+            woken_ = true;
+            cv_.notify_one();
+        }
+
+        std::shared_mutex mutex_; // guards the list, thread_ and paused_
+        std::mutex passMutex_; // held by the sampler for each pass over the gauges
+        std::vector<std::shared_ptr<GaugeState>> gauges_;
+        std::thread thread_;
+        bool paused_ = false; // by stop(), until resume()
+        std::atomic<bool> stopping_ { false };
+
+        std::mutex waitMutex_; // also guards the descriptors against wake()
+        std::condition_variable cv_;
+        bool woken_ = false;
+#if defined(__linux__)
+        int timerFd_ = -1;
+        int wakeFd_ = -1;
+#endif
+    };
+
+    // Resident set size of this process, or 0 where unsupported.
+    static uint64_t processRssBytes()
+    {
+#if defined(__linux__)
+        FILE* f = std::fopen("/proc/self/statm", "r");
+        if (!f)
+            return 0;
+        unsigned long long size = 0, resident = 0;
+        int n = std::fscanf(f, "%llu %llu", &size, &resident);
+        std::fclose(f);
+        return n == 2 ? resident * static_cast<uint64_t>(sysconf(_SC_PAGESIZE)) : 0;
+#else
+        return 0;
+#endif
+    }
+
+    // ---------------------------------------------------------------------------
+    // Entity response cache (for apps implementing onGetEntityVersion)
+    // ---------------------------------------------------------------------------
+
+    // LRU of serialized entity bodies; an entry only answers for the version
+    // and float precision it was serialized at.
+    class EntityCache {
+    public:
+        static constexpr size_t kCapacity = 512;
+
+        std::shared_ptr<const std::string> get(uintptr_t id, uint64_t version, int precision)
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto it = index_.find(id);
+            if (it == index_.end() || it->second->version != version || it->second->precision != precision)
+                return nullptr;
+            lru_.splice(lru_.begin(), lru_, it->second);
+            return it->second->body;
+        }
+
+        void put(uintptr_t id, uint64_t version, int precision, std::shared_ptr<const std::string> body)
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto it = index_.find(id);
+            if (it != index_.end()) {
+                it->second->version = version;
+                it->second->precision = precision;
+                it->second->body = std::move(body);
+                lru_.splice(lru_.begin(), lru_, it->second);
+                return;
+            }
+            lru_.push_front({ id, version, precision, std::move(body) });
+            index_[id] = lru_.begin();
+            if (lru_.size() > kCapacity) {
+                index_.erase(lru_.back().id);
+                lru_.pop_back();
+            }
+        }
+
+        struct Key {
+            uintptr_t id;
+            uint64_t version;
+            int precision;
+        };
+
+        // The `n` most recently used entries, most recent first
+        std::vector<Key> recent(size_t n)
+        {
+            std::vector<Key> keys;
+            std::lock_guard<std::mutex> lock(mutex_);
+            for (auto it = lru_.begin(); it != lru_.end() && keys.size() < n; ++it)
+                keys.push_back({ it->id, it->version, it->precision });
+            return keys;
+        }
+
+    private:
+        struct Entry {
+            uintptr_t id;
+            uint64_t version;
+            int precision;
+            std::shared_ptr<const std::string> body;
+        };
+
+        std::mutex mutex_;
+        std::list<Entry> lru_;
+        std::unordered_map<uintptr_t, std::list<Entry>::iterator> index_;
+    };
+
+    // Long-poll (?wait=) tuning: scene changes are noticed by re-reading the
+    // scene, at most every kMinProbeMs and at least every kMaxProbeMs (sooner
+    // when a frame is recorded)
+    static constexpr uint64_t kMaxWaitMs = 60000;
+    static constexpr int kMinProbeMs = 50;
+    static constexpr int kMaxProbeMs = 250;
+
+    // Everything cached for one scene source: the server itself or a World
+    struct WorldState {
+        FrameHistory frames;
+
+        // Last scene body and the hash of the node list it came from; the
+        // generation is bumped whenever that hash changes. `sceneSnapshots`
+        // counts the node lists published, so the precompute thread can tell
+        // whether one was published while it built its own.
+        std::mutex sceneMutex;
+        SceneSerializer scene;
+        uint64_t sceneHash = 0;
+        uint64_t sceneGeneration = 0;
+        uint64_t sceneSnapshots = 0;
+        std::shared_ptr<const std::string> sceneBody;
+
+        EntityCache entities;
+
+        // Rebuilt at most once per recorded frame (every request if the
+        // source records none)
+        std::mutex merkleMutex;
+        MerkleTree merkle;
+        std::optional<uint64_t> merkleFrame;
+
+        // Parked ?wait= requests sleep on `changed` until `wakeups` moves:
+        // on every recorded frame, scene generation bump and server stop
+        std::mutex waitMutex;
+        std::condition_variable changed;
+        uint64_t wakeups = 0;
+        std::atomic<int> waiting { 0 };
+        uint64_t probedFrame = 0;
+        std::chrono::steady_clock::time_point probedAt;
+
+        // Last frame the precompute thread caught up with, and the
+        // serializer it builds scene bodies with outside sceneMutex (its own
+        // use only)
+        uint64_t precomputedFrame = 0;
+        std::chrono::steady_clock::time_point precomputedAt;
+        SceneSerializer precomputedScene;
+
+        void wake()
+        {
+            if (waiting.load() == 0)
+                return;
+            {
+                std::lock_guard<std::mutex> lock(waitMutex);
+                ++wakeups;
+            }
+            changed.notify_all();
+        }
+
+        // True for the one waiter that should re-read the scene on behalf
+        // of all of them
+        bool claimProbe()
+        {
+            uint64_t frame = frames.latest();
+            auto now = std::chrono::steady_clock::now();
+            std::lock_guard<std::mutex> lock(waitMutex);
+            auto since = now - probedAt;
+            if (since < std::chrono::milliseconds(kMinProbeMs) || (frame == probedFrame && since < std::chrono::milliseconds(kMaxProbeMs)))
+                return false;
+            probedFrame = frame;
+            probedAt = now;
+            return true;
+        }
+    };
+
+    // Handshake between an /api/export request and the game thread, which
+    // forks at its next recordFrame()
+    struct ExportSlot {
+        std::mutex busy; // one export at a time; others get 409
+        std::mutex mutex;
+        std::condition_variable cv;
+        std::atomic<bool> pending { false };
+        bool done = false;
+        int precision = -1;
+        int fd = -1; // read end of the child's pipe, -1 if the fork failed
+        int pid = -1;
+        double forkMs = 0.0;
+        uint64_t frame = 0;
+    };
+
+    // Server::setPrecomputeBudget's thread, running while the server is
+    // started (or mounted on a started Host) with a non-zero budget
+    struct Precompute {
+        std::atomic<float> budget { 0.0f }; // share of one core
+        std::mutex mutex; // guards `thread` and `stopping`
+        std::condition_variable cv;
+        bool stopping = false;
+        std::thread thread;
+    };
+
+    // Handler runs of main-thread custom routes, waiting for the game
+    // thread's next recordFrame()
+    struct MainThreadJob {
+        std::function<void()> run;
+        bool done = false;
+    };
+
+    struct MainThreadQueue {
+        std::atomic<bool> pending { false };
+        std::mutex mutex;
+        std::condition_variable cv;
+        std::vector<MainThreadJob*> jobs;
+        std::vector<std::function<void()>> posted; // Server::runOnMainThread, nobody waits
+    };
+
+    // Server::runInBackground's threads
+    struct BackgroundPool {
+        static constexpr int kThreads = 2;
+
+        std::mutex mutex;
+        std::condition_variable cv;
+        std::deque<std::function<void()>> jobs;
+        std::vector<std::thread> threads;
+        bool stopping = false;
+    };
+
+    struct ServerState {
+        WorldState main;
+        ExportSlot exports;
+        Precompute precompute;
+        MainThreadQueue mainThread;
+        BackgroundPool background;
+
+        // Server::route endpoints, never removed; the lock only guards the list
+        std::mutex routesMutex;
+        std::vector<std::shared_ptr<CustomRoute>> routes;
+
+        // Registered worlds; the lock only guards the map, each world's
+        // caches have their own
+        std::shared_mutex worldsMutex;
+        std::map<std::string, std::shared_ptr<World>> worlds;
+
+        // Registered loops, never removed; the lock only guards the list
+        std::shared_mutex loopsMutex;
+        std::vector<std::unique_ptr<FrameLoop>> loops;
+
+        // Registered job graphs, never removed, like loops
+        std::shared_mutex jobGraphsMutex;
+        std::vector<std::unique_ptr<JobGraph>> jobGraphs;
+
+        GaugeSampler gauges;
+
+        // Server::setFloatPrecision; -1 is shortest round-trip
+        std::atomic<int> floatPrecision { -1 };
+
+        // Each parked ?wait= request holds a CivetWeb worker, so at most
+        // `maxParked` may park at once (a couple of workers short of the
+        // pool). `closing` releases them all when the server stops.
+        std::atomic<int> parked { 0 };
+        std::atomic<int> maxParked { 0 };
+        std::atomic<bool> closing { false };
+
+        // Requests inside a handler, parked ones included
+        std::atomic<int> active { 0 };
+
+        // Path prefix when mounted on a Host ("" when serving standalone)
+        std::string prefix;
+    };
+
+    struct HostState {
+        std::mutex mutex;
+        std::map<std::string, Server*> mounts; // prefix -> server
+    };
+
+    // ---------------------------------------------------------------------------
+    // HTTP helpers
+    // ---------------------------------------------------------------------------
+
+    static const char* statusText(int status)
+    {
+        switch (status) {
+        case 200:
+            return "OK";
+        case 304:
+            return "Not Modified";
+        case 400:
+            return "Bad Request";
+        case 404:
+            return "Not Found";
+        case 405:
+            return "Method Not Allowed";
+        case 409:
+            return "Conflict";
+        case 413:
+            return "Payload Too Large";
+        case 500:
+            return "Internal Server Error";
+        case 501:
+            return "Not Implemented";
+        case 503:
+            return "Service Unavailable";
+        default:
+            return "Error";
+        }
+    }
+
+    // ETag and, for scenes and versioned entities, the version to pass back
+    // as ?since= when long-polling
+    static std::string validatorHeaders(const char* etag, std::optional<uint64_t> version)
+    {
+        std::string headers = std::string("ETag: ") + etag + "\r\n"
+            + "Cache-Control: no-cache\r\n";
+        if (version) {
+            headers += "X-Reflector-Version: " + std::to_string(*version) + "\r\n"
+                + "Access-Control-Expose-Headers: ETag, X-Reflector-Version\r\n";
+        } else {
+            headers += "Access-Control-Expose-Headers: ETag\r\n";
+        }
+        return headers;
+    }
+
+    // `etag` (quoted) makes the response revalidatable via If-None-Match
+    static void sendBody(struct mg_connection* conn, int status, const std::string& body, const char* etag = nullptr,
+        std::optional<uint64_t> version = std::nullopt)
+    {
+        std::string validators;
+        if (etag)
+            validators = validatorHeaders(etag, version);
+        mg_printf(conn,
+            "HTTP/1.1 %d %s\r\n"
+            "Content-Type: application/json\r\n"
+            "Access-Control-Allow-Origin: *\r\n"
+            "%s"
+            "%s"
+            "Content-Length: %zu\r\n"
+            "Connection: keep-alive\r\n"
+            "\r\n",
+            status, statusText(status), validators.c_str(), serverTimingHeaders().c_str(),
+            body.size());
+        mg_write(conn, body.data(), body.size());
+    }
+
+    static void sendNotModified(struct mg_connection* conn, const char* etag, std::optional<uint64_t> version = std::nullopt)
+    {
+        mg_printf(conn,
+            "HTTP/1.1 304 Not Modified\r\n"
+            "Access-Control-Allow-Origin: *\r\n"
+            "%s"
+            "%s"
+            "Connection: keep-alive\r\n"
+            "\r\n",
+            validatorHeaders(etag, version).c_str(), serverTimingHeaders().c_str());
+    }
+
+    // True if an If-None-Match value lists `etag` (or is "*")
+    static bool etagMatches(const char* ifNoneMatch, const std::string& etag)
+    {
+        return ifNoneMatch && (std::strstr(ifNoneMatch, etag.c_str()) != nullptr || std::strcmp(ifNoneMatch, "*") == 0);
+    }
+
+    static void sendJson(struct mg_connection* conn, int status, const nlohmann::json& j)
+    {
+        sendBody(conn, status, j.dump());
+    }
+
+    // A response built without a connection, so a handler can send it or
+    // /api/batch can embed it in its own body
+    struct Reply {
+        int status;
+        std::shared_ptr<const std::string> body; // JSON; null for 304
+        std::string etag; // quoted; empty if not revalidatable
+        std::optional<uint64_t> version = std::nullopt; // scene generation or entity version
+    };
+
+    static Reply bodyReply(std::string body)
+    {
+        return { 200, std::make_shared<const std::string>(std::move(body)), {} };
+    }
+
+    static Reply errorReply(int status, const char* message)
+    {
+        return { status, std::make_shared<const std::string>(nlohmann::json { { "error", message } }.dump()), {} };
+    }
+
+    static int sendReply(struct mg_connection* conn, const Reply& reply)
+    {
+        if (reply.status == 304)
+            sendNotModified(conn, reply.etag.c_str(), reply.version);
+        else
+            sendBody(conn, reply.status, *reply.body, reply.etag.empty() ? nullptr : reply.etag.c_str(), reply.version);
+        return reply.status;
+    }
+
+    // Unsigned integer query parameter, or `fallback` if absent/malformed.
+    static uint64_t queryUInt(const struct mg_request_info* req, const char* name, uint64_t fallback)
+    {
+        if (!req->query_string)
+            return fallback;
+        char buf[32];
+        int n = mg_get_var(req->query_string, std::strlen(req->query_string), name, buf, sizeof(buf));
+        if (n <= 0)
+            return fallback;
+        uint64_t v = 0;
+        auto [ptr, ec] = std::from_chars(buf, buf + n, v);
+        return ec == std::errc {} ? v : fallback;
+    }
+
+    // ?precision=N (0-17) if given, else the server-wide setting
+    static int queryPrecision(const struct mg_request_info* req, const ServerState& state)
+    {
+        uint64_t digits = queryUInt(req, "precision", ~0ull);
+        return digits <= 17 ? static_cast<int>(digits) : state.floatPrecision.load(std::memory_order_relaxed);
+    }
+
+    static void sendCorsOptions(struct mg_connection* conn)
+    {
+        mg_printf(conn,
+            "HTTP/1.1 204 No Content\r\n"
+            "Access-Control-Allow-Origin: *\r\n"
+            "Access-Control-Allow-Methods: GET, POST, OPTIONS\r\n"
+            "Access-Control-Allow-Headers: Content-Type, If-None-Match\r\n"
+            "%s"
+            "Content-Length: 0\r\n"
+            "\r\n",
+            serverTimingHeaders().c_str());
+    }
+
+    // ---------------------------------------------------------------------------
+    // CivetWeb request handlers (C callbacks)
+    // ---------------------------------------------------------------------------
+
+    // Friend accessor: bridges C callbacks to protected virtual methods.
+    // Overloaded for Server and World so the serve* templates take either.
+    struct ServerAccess {
+        // The application's callbacks, timed as the "app" phase
+        static PerfMetrics getPerf(Server* s)
+        {
+            PhaseTimer timer(Phase::App);
+            return s->onGetPerf();
+        }
+        static std::vector<SceneNode> getScene(Server* s)
+        {
+            PhaseTimer timer(Phase::App);
+            return s->onGetScene();
+        }
+        static std::optional<EntityInfo> getEntity(Server* s, uintptr_t id)
+        {
+            PhaseTimer timer(Phase::App);
+            return s->onGetEntity(id);
+        }
+        static std::optional<uint64_t> getEntityVersion(Server* s, uintptr_t id)
+        {
+            PhaseTimer timer(Phase::App);
+            return s->onGetEntityVersion(id);
+        }
+        static ServerState& state(Server* s) { return *s->state_; }
+        static WorldState& world(Server* s) { return s->state_->main; }
+        static void batch(Server* s, const std::function<void()>& run)
+        {
+            PhaseTimer timer(Phase::App);
+            s->onBatch(run);
+        }
+
+        static PerfMetrics getPerf(World* w)
+        {
+            PhaseTimer timer(Phase::App);
+            return w->onGetPerf();
+        }
+        static std::vector<SceneNode> getScene(World* w)
+        {
+            PhaseTimer timer(Phase::App);
+            return w->onGetScene();
+        }
+        static std::optional<EntityInfo> getEntity(World* w, uintptr_t id)
+        {
+            PhaseTimer timer(Phase::App);
+            return w->onGetEntity(id);
+        }
+        static std::optional<uint64_t> getEntityVersion(World* w, uintptr_t id)
+        {
+            PhaseTimer timer(Phase::App);
+            return w->onGetEntityVersion(id);
+        }
+        static WorldState& world(World* w) { return *w->state_; }
+
+        static JsonOut jsonOut(std::string& out, int precision) { return JsonOut(out, precision); }
+        static bool tooDeep(const JsonOut& o) { return o.tooDeep_; }
+        static AsyncToken& token(const RouteResponder& r) { return *r.token_; }
+        static RouteResponder responder(std::shared_ptr<AsyncToken> token)
+        {
+            RouteResponder r;
+            r.token_ = std::move(token);
+            return r;
+        }
+
+        static const LoopState& loop(const FrameLoop* l) { return *l->state_; }
+        static float targetHz(const FrameLoop* l) { return l->targetHz_; }
+        static const JobGraphState& jobGraph(const JobGraph* g) { return *g->state_; }
+    };
+
+    static const LoopState& loopState(const FrameLoop* loop) { return ServerAccess::loop(loop); }
+
+    template <typename Source>
+    static Reply perfReply(Source* source, int precision)
+    {
+        auto metrics = ServerAccess::getPerf(source);
+        std::string body;
+        JsonWriter w(body, precision);
+        writePerf(w, metrics);
+        return bodyReply(std::move(body));
+    }
+
+    template <typename Source>
+    static Reply framesReply(Source* source, uint64_t since, int precision)
+    {
+        std::string body;
+        JsonWriter w(body, precision);
+        w.raw("{", 1);
+        ServerAccess::world(source).frames.writeSince(w, since);
+        w.raw(",\"rssBytes\":");
+        w.uint(processRssBytes());
+        w.raw("}", 1);
+        return bodyReply(std::move(body));
+    }
+
+    template <typename Source>
+    static Reply pacingReply(Source* source, int precision)
+    {
+        std::string body;
+        JsonWriter w(body, precision);
+        ServerAccess::world(source).frames.writePacing(w);
+        return bodyReply(std::move(body));
+    }
+
+    static std::string sceneEtag(uint64_t hash)
+    {
+        char etag[20];
+        std::snprintf(etag, sizeof(etag), "\"%016llx\"", static_cast<unsigned long long>(hash));
+        return etag;
+    }
+
+    template <typename Source>
+    static Reply sceneReply(Source* source, const char* ifNoneMatch)
+    {
+        auto& state = ServerAccess::world(source);
+
+        // The snapshot is taken and published under one lock: two requests
+        // publishing in the opposite order to their snapshots would flip the
+        // generation back to an older scene, flapping the ETag and waking
+        // long polls for nothing
+        std::shared_ptr<const std::string> body;
+        uint64_t hash;
+        uint64_t generation = 0;
+        bool matched;
+        bool bumped = false;
+        {
+            std::lock_guard<std::mutex> lock(state.sceneMutex);
+            auto nodes = ServerAccess::getScene(source);
+            ++state.sceneSnapshots;
+
+            // An unchanged node list skips tree building and serialization
+            {
+                PhaseTimer timer(Phase::Hash);
+                hash = hashScene(nodes);
+            }
+            matched = etagMatches(ifNoneMatch, sceneEtag(hash));
+            if (state.sceneGeneration == 0 || state.sceneHash != hash) {
+                state.sceneHash = hash;
+                state.sceneBody = nullptr;
+                ++state.sceneGeneration;
+                bumped = true;
+            }
+            if (!matched && !state.sceneBody)
+                state.sceneBody = state.scene.serialize(nodes);
+            body = state.sceneBody;
+            generation = state.sceneGeneration;
+        }
+        if (bumped)
+            state.wake();
+        if (matched)
+            return { 304, nullptr, sceneEtag(hash), generation };
+        return { 200, std::move(body), sceneEtag(hash), generation };
+    }
+
+    // Serializes a versioned entity into the cache; null if it is gone
+    template <typename Source>
+    static std::shared_ptr<const std::string> cacheEntity(Source* source, uintptr_t id, uint64_t version, int precision)
+    {
+        auto entity = ServerAccess::getEntity(source, id);
+        if (!entity)
+            return nullptr;
+        std::string out;
+        {
+            PhaseTimer timer(Phase::Serialize);
+            JsonWriter w(out, precision);
+            writeEntity(w, *entity);
+        }
+        auto body = std::make_shared<const std::string>(std::move(out));
+        ServerAccess::world(source).entities.put(id, version, precision, body);
+        return body;
+    }
+
+    // `idStr`: the decimal id from the URI
+    template <typename Source>
+    static Reply entityReply(Source* source, const char* idStr, int precision, const char* ifNoneMatch)
+    {
+        uintptr_t id = 0;
+        auto [ptr, ec] = std::from_chars(idStr, idStr + std::strlen(idStr), id);
+        if (ec != std::errc {})
+            return errorReply(404, "Invalid entity ID");
+
+        auto version = ServerAccess::getEntityVersion(source, id);
+        if (!version) {
+            auto entity = ServerAccess::getEntity(source, id);
+            if (!entity)
+                return errorReply(404, "Entity not found");
+            std::string body;
+            PhaseTimer timer(Phase::Serialize);
+            JsonWriter w(body, precision);
+            writeEntity(w, *entity);
+            return bodyReply(std::move(body));
+        }
+
+        // Versioned: revalidate, then serve from the cache when possible. The
+        // precision is part of the representation, hence of the ETag.
+        std::string etag = "\"" + std::to_string(id) + "-" + std::to_string(*version);
+        if (precision >= 0)
+            etag += "-p" + std::to_string(precision);
+        etag += "\"";
+        if (etagMatches(ifNoneMatch, etag))
+            return { 304, nullptr, std::move(etag), version };
+
+        auto body = ServerAccess::world(source).entities.get(id, *version, precision);
+        if (!body)
+            body = cacheEntity(source, id, *version, precision);
+        if (!body)
+            return errorReply(404, "Entity not found");
+        return { 200, std::move(body), std::move(etag), version };
+    }
+
+    // `path`: child indices from the scene root, e.g. "0/3/1". The whole
+    // tree is rebuilt for the first request after each recorded frame (for
+    // every request if the source records none), which calls onGetScene()
+    // and onGetEntity() for every node without a version.
+    template <typename Source>
+    static Reply merkleReply(Source* source, const std::string& path)
+    {
+        auto& state = ServerAccess::world(source);
+        std::lock_guard<std::mutex> lock(state.merkleMutex);
+        uint64_t frame = state.frames.latest();
+        if (!state.merkleFrame || frame == 0 || *state.merkleFrame != frame) {
+            PhaseTimer timer(Phase::Build);
+            state.merkle.build(
+                ServerAccess::getScene(source),
+                [&](uintptr_t id) { return ServerAccess::getEntityVersion(source, id); },
+                [&](uintptr_t id) { return ServerAccess::getEntity(source, id); });
+            state.merkleFrame = frame;
+        }
+
+        auto node = state.merkle.find(path);
+        if (!node)
+            return errorReply(404, "No node at path");
+        std::string body;
+        PhaseTimer timer(Phase::Serialize);
+        JsonWriter w(body);
+        state.merkle.write(w, path, *node, frame);
+        return bodyReply(std::move(body));
+    }
+
+    // ?path= for /api/merkle ("" if absent)
+    static std::string queryPath(const struct mg_request_info* req)
+    {
+        if (!req->query_string)
+            return {};
+        size_t len = std::strlen(req->query_string);
+        std::string path(len + 1, '\0');
+        int n = mg_get_var(req->query_string, len, "path", path.data(), path.size());
+        path.resize(n > 0 ? static_cast<size_t>(n) : 0);
+        return path;
+    }
+
+    // ---------------------------------------------------------------------------
+    // Long polling: ?wait=<ms>&since=<version> on scene and entity routes
+    // parks the request until the version moves past `since` or the wait
+    // expires (then 304). CivetWeb has no way to suspend a request, so a
+    // parked request sleeps on its worker thread; it never spins.
+    // ---------------------------------------------------------------------------
+
+    struct LongPoll {
+        uint64_t waitMs = 0; // 0: answer right away
+        uint64_t since = 0;
+    };
+
+    // Waiting needs both parameters
+    static LongPoll queryLongPoll(const struct mg_request_info* req)
+    {
+        LongPoll poll;
+        poll.since = queryUInt(req, "since", ~0ull);
+        if (poll.since != ~0ull)
+            poll.waitMs = std::min(queryUInt(req, "wait", 0), kMaxWaitMs);
+        return poll;
+    }
+
+    // Sleeps until `check()` reports a change, `deadline` passes or the
+    // server stops. `check` runs again after every wake() and at least every
+    // kMaxProbeMs.
+    template <typename Check>
+    static bool parkUntil(ServerState& server, WorldState& state, std::chrono::steady_clock::time_point deadline, Check&& check)
+    {
+        PhaseTimer timer(Phase::Wait);
+        state.waiting.fetch_add(1);
+        bool changed = false;
+        for (;;) {
+            uint64_t seen = 0;
+            {
+                std::lock_guard<std::mutex> lock(state.waitMutex);
+                seen = state.wakeups;
+            }
+            changed = check();
+            auto now = std::chrono::steady_clock::now();
+            if (changed || now >= deadline || server.closing.load())
+                break;
+            std::unique_lock<std::mutex> lock(state.waitMutex);
+            state.changed.wait_until(lock, std::min(deadline, now + std::chrono::milliseconds(kMaxProbeMs)),
+                [&] { return state.wakeups != seen; });
+        }
+        state.waiting.fetch_sub(1);
+        return changed;
+    }
+
+    // Scene changes are only visible by calling onGetScene(), so one waiter
+    // at a time (see WorldState::claimProbe) re-reads it for all of them;
+    // the others see the generation bump.
+    template <typename Source>
+    static Reply waitScene(ServerState& server, Source* source, const LongPoll& poll, const char* ifNoneMatch)
+    {
+        auto& state = ServerAccess::world(source);
+        std::optional<Reply> reply;
+        parkUntil(server, state, std::chrono::steady_clock::now() + std::chrono::milliseconds(poll.waitMs), [&] {
+            uint64_t generation = 0;
+            {
+                std::lock_guard<std::mutex> lock(state.sceneMutex);
+                generation = state.sceneGeneration;
+            }
+            if (generation != 0 && generation != poll.since) {
+                reply = sceneReply(source, ifNoneMatch);
+                return true;
+            }
+            if (!state.claimProbe())
+                return false;
+            Reply probe = sceneReply(source, ifNoneMatch);
+            if (probe.version == poll.since)
+                return false;
+            reply = std::move(probe);
+            return true;
+        });
+        if (reply)
+            return *reply;
+
+        std::lock_guard<std::mutex> lock(state.sceneMutex);
+        return { 304, nullptr, sceneEtag(state.sceneHash), state.sceneGeneration };
+    }
+
+    // Entity versions are cheap by contract, so every waiter checks its own
+    // on each wake. Entities without a version are answered right away.
+    template <typename Source>
+    static Reply waitEntity(ServerState& server, Source* source, const char* idStr, int precision, const LongPoll& poll, const char* ifNoneMatch)
+    {
         uintptr_t id = 0;
         auto [ptr, ec] = std::from_chars(idStr, idStr + std::strlen(idStr), id);
-        if (ec != std::errc {}) {
-            sendJson(conn, 404, { { "error", "Invalid entity ID" } });
+        if (ec == std::errc {}) {
+            parkUntil(server, ServerAccess::world(source), std::chrono::steady_clock::now() + std::chrono::milliseconds(poll.waitMs), [&] {
+                auto version = ServerAccess::getEntityVersion(source, id);
+                return !version || *version != poll.since;
+            });
+        }
+        Reply reply = entityReply(source, idStr, precision, ifNoneMatch);
+        if (reply.status == 200 && reply.version == poll.since)
+            return { 304, nullptr, std::move(reply.etag), reply.version };
+        return reply;
+    }
+
+    // Sends `wait()` if the request asked to wait and a parking slot is
+    // free, else `now()`. Over the limit the client gets 503 rather than an
+    // immediate answer it would re-poll in a tight loop.
+    template <typename Wait, typename Now>
+    static int serveLongPoll(struct mg_connection* conn, ServerState& server, const LongPoll& poll, Wait&& wait, Now&& now)
+    {
+        if (poll.waitMs == 0)
+            return sendReply(conn, now());
+        if (server.parked.fetch_add(1) >= server.maxParked.load()) {
+            server.parked.fetch_sub(1);
+            return sendReply(conn, errorReply(503, "Too many waiting requests"));
+        }
+        int status = sendReply(conn, wait());
+        server.parked.fetch_sub(1);
+        return status;
+    }
+
+    // Wakes every parked request and waits (briefly) for their answers to
+    // go out: CivetWeb drops writes once it is stopping
+    static void releaseWaiters(ServerState& server)
+    {
+        server.closing.store(true);
+        server.main.wake();
+        {
+            std::lock_guard<std::mutex> lock(server.mainThread.mutex);
+        }
+        server.mainThread.cv.notify_all();
+        {
+            std::shared_lock<std::shared_mutex> lock(server.worldsMutex);
+            for (auto& [name, world] : server.worlds)
+                ServerAccess::world(world.get()).wake();
+        }
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(2 * kMaxProbeMs);
+        while (server.parked.load() > 0 && std::chrono::steady_clock::now() < deadline)
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    static int handlePerf(struct mg_connection* conn, void* cbdata)
+    {
+        auto* req = mg_get_request_info(conn);
+        if (std::strcmp(req->request_method, "OPTIONS") == 0) {
+            sendCorsOptions(conn);
+            return 204;
+        }
+        auto* server = static_cast<Server*>(cbdata);
+        return sendReply(conn, perfReply(server, queryPrecision(req, ServerAccess::state(server))));
+    }
+
+    static int handlePerfFrames(struct mg_connection* conn, void* cbdata)
+    {
+        auto* req = mg_get_request_info(conn);
+        if (std::strcmp(req->request_method, "OPTIONS") == 0) {
+            sendCorsOptions(conn);
+            return 204;
+        }
+        auto* server = static_cast<Server*>(cbdata);
+        return sendReply(conn, framesReply(server, queryUInt(req, "since", 0), queryPrecision(req, ServerAccess::state(server))));
+    }
+
+    static int handlePacing(struct mg_connection* conn, void* cbdata)
+    {
+        auto* req = mg_get_request_info(conn);
+        if (std::strcmp(req->request_method, "OPTIONS") == 0) {
+            sendCorsOptions(conn);
+            return 204;
+        }
+        auto* server = static_cast<Server*>(cbdata);
+        return sendReply(conn, pacingReply(server, queryPrecision(req, ServerAccess::state(server))));
+    }
+
+    static int handleScene(struct mg_connection* conn, void* cbdata)
+    {
+        auto* req = mg_get_request_info(conn);
+        if (std::strcmp(req->request_method, "OPTIONS") == 0) {
+            sendCorsOptions(conn);
+            return 204;
+        }
+        auto* server = static_cast<Server*>(cbdata);
+        auto& state = ServerAccess::state(server);
+        const char* ifNoneMatch = mg_get_header(conn, "If-None-Match");
+        auto poll = queryLongPoll(req);
+        return serveLongPoll(conn, state, poll, [&] { return waitScene(state, server, poll, ifNoneMatch); }, [&] { return sceneReply(server, ifNoneMatch); });
+    }
+
+    static int handleEntity(struct mg_connection* conn, void* cbdata)
+    {
+        auto* req = mg_get_request_info(conn);
+        if (std::strcmp(req->request_method, "OPTIONS") == 0) {
+            sendCorsOptions(conn);
+            return 204;
+        }
+
+        // Parse entity ID from URI: /api/entity/<id>
+        const char* uri = req->local_uri;
+        const char* idStr = std::strrchr(uri, '/');
+        if (!idStr || *(idStr + 1) == '\0') {
+            sendJson(conn, 404, { { "error", "Missing entity ID" } });
+            return 404;
+        }
+        auto* server = static_cast<Server*>(cbdata);
+        auto& state = ServerAccess::state(server);
+        int precision = queryPrecision(req, state);
+        const char* ifNoneMatch = mg_get_header(conn, "If-None-Match");
+        auto poll = queryLongPoll(req);
+        return serveLongPoll(conn, state, poll, [&] { return waitEntity(state, server, idStr + 1, precision, poll, ifNoneMatch); }, [&] { return entityReply(server, idStr + 1, precision, ifNoneMatch); });
+    }
+
+    static int handleMerkle(struct mg_connection* conn, void* cbdata)
+    {
+        auto* req = mg_get_request_info(conn);
+        if (std::strcmp(req->request_method, "OPTIONS") == 0) {
+            sendCorsOptions(conn);
+            return 204;
+        }
+        return sendReply(conn, merkleReply(static_cast<Server*>(cbdata), queryPath(req)));
+    }
+
+    static int handleWorlds(struct mg_connection* conn, void* cbdata)
+    {
+        auto* req = mg_get_request_info(conn);
+        if (std::strcmp(req->request_method, "OPTIONS") == 0) {
+            sendCorsOptions(conn);
+            return 204;
+        }
+        auto& state = ServerAccess::state(static_cast<Server*>(cbdata));
+        std::string body;
+        JsonWriter w(body);
+        w.raw("{\"worlds\":[");
+        {
+            std::shared_lock<std::shared_mutex> lock(state.worldsMutex);
+            bool first = true;
+            for (auto& [name, world] : state.worlds) {
+                w.raw(first ? "{\"name\":" : ",{\"name\":");
+                w.string(name);
+                w.raw("}", 1);
+                first = false;
+            }
+        }
+        w.raw("]}", 2);
+        sendBody(conn, 200, body);
+        return 200;
+    }
+
+    // Callers hold the reference, not the registry lock, while serving
+    static std::shared_ptr<World> findWorld(ServerState& state, const std::string& name)
+    {
+        std::shared_lock<std::shared_mutex> lock(state.worldsMutex);
+        auto it = state.worlds.find(name);
+        return it != state.worlds.end() ? it->second : nullptr;
+    }
+
+    // /api/w/<world>/{perf, perf/frames, perf/pacing, scene, entity/<id>}
+    static int handleWorld(struct mg_connection* conn, void* cbdata)
+    {
+        auto* req = mg_get_request_info(conn);
+        if (std::strcmp(req->request_method, "OPTIONS") == 0) {
+            sendCorsOptions(conn);
+            return 204;
+        }
+
+        auto& state = ServerAccess::state(static_cast<Server*>(cbdata));
+        const char* name = req->local_uri + state.prefix.size() + std::strlen("/api/w/");
+        const char* slash = std::strchr(name, '/');
+        if (!slash) {
+            sendJson(conn, 404, { { "error", "Missing world route" } });
+            return 404;
+        }
+
+        auto world = findWorld(state, std::string(name, slash));
+        if (!world) {
+            sendJson(conn, 404, { { "error", "World not found" } });
+            return 404;
+        }
+
+        const char* route = slash + 1;
+        int precision = queryPrecision(req, state);
+        const char* ifNoneMatch = mg_get_header(conn, "If-None-Match");
+        if (std::strcmp(route, "perf") == 0)
+            return sendReply(conn, perfReply(world.get(), precision));
+        if (std::strcmp(route, "perf/frames") == 0)
+            return sendReply(conn, framesReply(world.get(), queryUInt(req, "since", 0), precision));
+        if (std::strcmp(route, "perf/pacing") == 0)
+            return sendReply(conn, pacingReply(world.get(), precision));
+        auto poll = queryLongPoll(req);
+        if (std::strcmp(route, "scene") == 0)
+            return serveLongPoll(conn, state, poll, [&] { return waitScene(state, world.get(), poll, ifNoneMatch); }, [&] { return sceneReply(world.get(), ifNoneMatch); });
+        if (std::strncmp(route, "entity/", 7) == 0 && route[7] != '\0')
+            return serveLongPoll(conn, state, poll, [&] { return waitEntity(state, world.get(), route + 7, precision, poll, ifNoneMatch); }, [&] { return entityReply(world.get(), route + 7, precision, ifNoneMatch); });
+        if (std::strcmp(route, "merkle") == 0)
+            return sendReply(conn, merkleReply(world.get(), queryPath(req)));
+
+        sendJson(conn, 404, { { "error", "Unknown world route" } });
+        return 404;
+    }
+
+    // ---------------------------------------------------------------------------
+    // Batch requests: several reads in one round trip, from one frame
+    // ---------------------------------------------------------------------------
+
+    static constexpr size_t kMaxBatchItems = 64;
+    static constexpr size_t kMaxBatchBytes = 64 * 1024;
+
+    struct BatchItem {
+        std::shared_ptr<World> world; // null for the server itself; held for the whole batch
+        const FrameHistory* frames = nullptr; // set once the sub-request has run
+        uint64_t frame = 0;
+        Reply reply { 400, nullptr, {} };
+    };
+
+    // Member `key` of a sub-request as a string, or "" if absent or not a string
+    static std::string batchString(const nlohmann::json& sub, const char* key)
+    {
+        auto it = sub.find(key);
+        return it != sub.end() && it->is_string() ? it->get<std::string>() : std::string();
+    }
+
+    template <typename Source>
+    static void runBatchItem(Source* source, const nlohmann::json& sub, int precision, BatchItem& item)
+    {
+        item.frames = &ServerAccess::world(source).frames;
+        item.frame = item.frames->latest();
+
+        std::string op = batchString(sub, "op");
+        std::string ifNoneMatch = batchString(sub, "ifNoneMatch");
+        const char* inm = ifNoneMatch.empty() ? nullptr : ifNoneMatch.c_str();
+        if (op == "perf") {
+            item.reply = perfReply(source, precision);
+        } else if (op == "frames") {
+            auto since = sub.find("since");
+            item.reply = framesReply(source, since != sub.end() && since->is_number_unsigned() ? since->get<uint64_t>() : 0, precision);
+        } else if (op == "pacing") {
+            item.reply = pacingReply(source, precision);
+        } else if (op == "scene") {
+            item.reply = sceneReply(source, inm);
+        } else if (op == "entity") {
+            auto id = sub.find("id");
+            std::string idStr = id == sub.end() ? std::string()
+                : id->is_number_unsigned()      ? std::to_string(id->get<uint64_t>())
+                                                : batchString(sub, "id");
+            item.reply = entityReply(source, idStr.c_str(), precision, inm);
+        } else {
+            item.frames = nullptr;
+            item.reply = errorReply(400, "Unknown op");
+        }
+    }
+
+    // POST /api/batch with an array of sub-requests, e.g.
+    //   [{"op":"perf"}, {"op":"scene","ifNoneMatch":"\"...\""},
+    //    {"op":"entity","id":42,"world":"match-1"}]
+    // Ops: perf, frames (optional "since"), pacing, scene and entity ("id");
+    // "world" targets a registered world. All sub-requests run inside one
+    // Server::onBatch call. Each result carries its status, ETag, body and
+    // the source's latest frame when it ran; "consistent" is false if any
+    // source recorded a frame before the batch finished.
+    static int handleBatch(struct mg_connection* conn, void* cbdata)
+    {
+        auto* req = mg_get_request_info(conn);
+        if (std::strcmp(req->request_method, "OPTIONS") == 0) {
+            sendCorsOptions(conn);
+            return 204;
+        }
+        if (std::strcmp(req->request_method, "POST") != 0) {
+            sendJson(conn, 405, { { "error", "Use POST" } });
+            return 405;
+        }
+        if (req->content_length > static_cast<long long>(kMaxBatchBytes)) {
+            sendJson(conn, 413, { { "error", "Batch too large" } });
+            return 413;
+        }
+
+        std::string text;
+        char buf[4096];
+        int n = 0;
+        while (text.size() <= kMaxBatchBytes && (n = mg_read(conn, buf, sizeof(buf))) > 0)
+            text.append(buf, static_cast<size_t>(n));
+        auto batch = nlohmann::json::parse(text, nullptr, false);
+        if (!batch.is_array() || batch.size() > kMaxBatchItems) {
+            sendJson(conn, 400, { { "error", "Expected an array of at most 64 sub-requests" } });
+            return 400;
+        }
+
+        auto* server = static_cast<Server*>(cbdata);
+        auto& state = ServerAccess::state(server);
+        int precision = queryPrecision(req, state);
+
+        // Worlds are resolved up front so the registry lock is never taken
+        // inside the application's
+        std::vector<BatchItem> items(batch.size());
+        std::vector<bool> valid(batch.size(), false);
+        for (size_t i = 0; i < batch.size(); ++i) {
+            if (!batch[i].is_object()) {
+                items[i].reply = errorReply(400, "Sub-request must be an object");
+                continue;
+            }
+            if (batch[i].contains("world")) {
+                items[i].world = findWorld(state, batchString(batch[i], "world"));
+                if (!items[i].world) {
+                    items[i].reply = errorReply(404, "World not found");
+                    continue;
+                }
+            }
+            valid[i] = true;
+        }
+
+        ServerAccess::batch(server, [&] {
+            for (size_t i = 0; i < items.size(); ++i) {
+                if (!valid[i])
+                    continue;
+                if (items[i].world)
+                    runBatchItem(items[i].world.get(), batch[i], precision, items[i]);
+                else
+                    runBatchItem(server, batch[i], precision, items[i]);
+            }
+        });
+
+        bool consistent = true;
+        for (auto& item : items) {
+            if (item.frames && item.frames->latest() != item.frame)
+                consistent = false;
+        }
+
+        std::string body;
+        JsonWriter w(body);
+        w.raw(consistent ? "{\"consistent\":true,\"results\":[" : "{\"consistent\":false,\"results\":[");
+        for (size_t i = 0; i < items.size(); ++i) {
+            const auto& item = items[i];
+            w.raw(i ? ",{\"status\":" : "{\"status\":");
+            w.integer(item.reply.status);
+            w.raw(",\"frame\":");
+            if (item.frames)
+                w.uint(item.frame);
+            else
+                w.raw("null", 4);
+            if (!item.reply.etag.empty()) {
+                w.raw(",\"etag\":");
+                w.string(item.reply.etag);
+            }
+            if (item.reply.version) {
+                w.raw(",\"version\":");
+                w.uint(*item.reply.version);
+            }
+            if (item.reply.body) {
+                w.raw(",\"body\":");
+                w.raw(item.reply.body->data(), item.reply.body->size());
+            }
+            w.raw("}", 1);
+        }
+        w.raw("]}", 2);
+        sendBody(conn, 200, body);
+        return 200;
+    }
+
+    // ---------------------------------------------------------------------------
+    // Idle-time precomputation: rebuilds cached scene and entity bodies after
+    // they change, before anyone asks, so the first request after a change
+    // doesn't pay for serialization
+    // ---------------------------------------------------------------------------
+
+    static constexpr int kPrecomputeTickMs = 20; // how often to look for work
+    static constexpr int kPrecomputeRefreshMs = 1000; // re-check sources that record no frames
+    static constexpr size_t kPrecomputeEntities = 32; // most recently requested, per source
+
+    // CPU time used by the calling thread (wall time where unavailable)
+    static int64_t threadCpuNs()
+    {
+#if defined(__linux__)
+        timespec ts;
+        if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) == 0)
+            return static_cast<int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+#endif
+        return loopClockNs();
+    }
+
+    // Only requests that are actually working count; parked ones are asleep
+    static bool serverIdle(const ServerState& server)
+    {
+        return server.active.load(std::memory_order_relaxed) <= server.parked.load(std::memory_order_relaxed);
+    }
+
+    // The precompute thread's sceneReply(). It runs at idle priority, so it
+    // reads and serializes the scene outside sceneMutex (requests would
+    // otherwise queue behind a thread that only runs when nothing else
+    // does) and installs the body only if no request published a snapshot
+    // meanwhile, which keeps the generation from going back to an older one.
+    template <typename Source>
+    static void precomputeScene(Source* source)
+    {
+        auto& state = ServerAccess::world(source);
+        uint64_t snapshots;
+        uint64_t publishedHash;
+        bool hasBody;
+        {
+            std::lock_guard<std::mutex> lock(state.sceneMutex);
+            if (state.sceneGeneration == 0)
+                return; // never requested
+            snapshots = state.sceneSnapshots;
+            publishedHash = state.sceneHash;
+            hasBody = state.sceneBody != nullptr;
+        }
+
+        auto nodes = ServerAccess::getScene(source);
+        uint64_t hash;
+        {
+            PhaseTimer timer(Phase::Hash);
+            hash = hashScene(nodes);
+        }
+        if (hash == publishedHash && hasBody)
+            return;
+        auto body = state.precomputedScene.serialize(nodes);
+
+        bool bumped = false;
+        {
+            std::lock_guard<std::mutex> lock(state.sceneMutex);
+            if (state.sceneSnapshots != snapshots)
+                return;
+            ++state.sceneSnapshots;
+            if (state.sceneHash != hash) {
+                state.sceneHash = hash;
+                ++state.sceneGeneration;
+                bumped = true;
+            }
+            state.sceneBody = std::move(body);
+        }
+        if (bumped)
+            state.wake();
+    }
+
+    // Brings one source's scene body (if the scene has been requested at
+    // all) and its recently requested entities up to date, once per recorded
+    // frame. Returns false if a request came in midway.
+    template <typename Source>
+    static bool precomputeSource(ServerState& server, Source* source)
+    {
+        auto& state = ServerAccess::world(source);
+        uint64_t frame = state.frames.latest();
+        auto now = std::chrono::steady_clock::now();
+        if (frame == state.precomputedFrame && now - state.precomputedAt < std::chrono::milliseconds(kPrecomputeRefreshMs))
+            return true;
+        state.precomputedFrame = frame;
+        state.precomputedAt = now;
+
+        precomputeScene(source);
+
+        for (auto& key : state.entities.recent(kPrecomputeEntities)) {
+            if (!serverIdle(server))
+                return false;
+            auto version = ServerAccess::getEntityVersion(source, key.id);
+            if (version && *version != key.version)
+                cacheEntity(source, key.id, *version, key.precision);
+        }
+        return true;
+    }
+
+    // The precompute thread. It runs at SCHED_IDLE where available, only
+    // works while no request is being served, and after each pass rests long
+    // enough that its CPU time stays within the budget.
+    static void precomputeLoop(Server* server)
+    {
+#if defined(__linux__) && defined(SCHED_IDLE)
+        sched_param param = {};
+        pthread_setschedparam(pthread_self(), SCHED_IDLE, &param);
+#endif
+        auto& state = ServerAccess::state(server);
+        auto& pre = state.precompute;
+        auto next = std::chrono::steady_clock::now();
+
+        std::unique_lock<std::mutex> lock(pre.mutex);
+        while (!pre.stopping) {
+            pre.cv.wait_until(lock, next, [&] { return pre.stopping; });
+            if (pre.stopping)
+                break;
+            auto now = std::chrono::steady_clock::now();
+            next = now + std::chrono::milliseconds(kPrecomputeTickMs);
+            float budget = pre.budget.load(std::memory_order_relaxed);
+            if (budget <= 0.0f || !serverIdle(state))
+                continue;
+
+            lock.unlock();
+            int64_t cpu = threadCpuNs();
+            if (precomputeSource(state, server)) {
+                std::vector<std::shared_ptr<World>> worlds;
+                {
+                    std::shared_lock<std::shared_mutex> worldsLock(state.worldsMutex);
+                    for (auto& [name, world] : state.worlds)
+                        worlds.push_back(world);
+                }
+                for (auto& world : worlds) {
+                    if (!serverIdle(state) || !precomputeSource(state, world.get()))
+                        break;
+                }
+            }
+            cpu = threadCpuNs() - cpu;
+            lock.lock();
+
+            // `cpu` out of every cpu / budget nanoseconds
+            auto rest = std::chrono::nanoseconds(static_cast<int64_t>(static_cast<double>(cpu) * (1.0 - budget) / budget));
+            next = std::max(next, now + rest);
+        }
+    }
+
+    static void startPrecompute(Server* server)
+    {
+        auto& pre = ServerAccess::state(server).precompute;
+        std::lock_guard<std::mutex> lock(pre.mutex);
+        if (pre.thread.joinable() || pre.budget.load() <= 0.0f)
+            return;
+        pre.stopping = false;
+        pre.thread = std::thread([server] { precomputeLoop(server); });
+    }
+
+    static void stopPrecompute(ServerState& state)
+    {
+        auto& pre = state.precompute;
+        std::thread thread;
+        {
+            std::lock_guard<std::mutex> lock(pre.mutex);
+            pre.stopping = true;
+            thread = std::move(pre.thread);
+        }
+        pre.cv.notify_all();
+        if (thread.joinable())
+            thread.join();
+    }
+
+    // Per-loop summary over the last `windowNs`, plus how much of that time
+    // two or more loops were running at once (pairwise and overall)
+    static void writeLoops(JsonWriter& w, const std::vector<FrameLoop*>& loops, int64_t windowNs)
+    {
+        int64_t now = loopClockNs();
+        int64_t from = now - windowNs;
+
+        // Spans inside the window, per loop, clipped to it
+        std::vector<std::vector<LoopState::Span>> spans(loops.size());
+        std::vector<LoopState::Span> buf;
+        for (size_t i = 0; i < loops.size(); ++i) {
+            uint64_t latest = 0;
+            loopState(loops[i]).copySince(0, buf, latest);
+            for (auto& span : buf) {
+                if (span.endNs > from)
+                    spans[i].push_back({ std::max(span.beginNs, from), span.endNs });
+            }
+        }
+
+        w.raw("{\"windowMs\":");
+        w.number(static_cast<double>(windowNs) / 1e6);
+        w.raw(",\"loops\":[");
+        for (size_t i = 0; i < loops.size(); ++i) {
+            const auto& s = spans[i];
+            double busyNs = 0.0, maxNs = 0.0;
+            for (auto& span : s) {
+                double d = static_cast<double>(span.endNs - span.beginNs);
+                busyNs += d;
+                maxNs = std::max(maxNs, d);
+            }
+            double rateHz = s.size() > 1 ? (s.size() - 1) * 1e9 / static_cast<double>(s.back().beginNs - s.front().beginNs) : 0.0;
+
+            w.raw(i ? ",{\"name\":" : "{\"name\":");
+            w.string(loops[i]->name());
+            w.raw(",\"targetHz\":");
+            w.number(ServerAccess::targetHz(loops[i]));
+            w.raw(",\"latest\":");
+            w.uint(loopState(loops[i]).head.load(std::memory_order_acquire));
+            w.raw(",\"iterations\":");
+            w.uint(s.size());
+            w.raw(",\"rateHz\":");
+            w.number(rateHz);
+            w.raw(",\"avgMs\":");
+            w.number(s.empty() ? 0.0 : busyNs / s.size() / 1e6);
+            w.raw(",\"maxMs\":");
+            w.number(maxNs / 1e6);
+            w.raw(",\"busy\":");
+            w.number(busyNs / static_cast<double>(windowNs));
+            w.raw("}", 1);
+        }
+
+        // Sweep over begin/end events: per-pair overlap and time with two or
+        // more loops active. Loops are few, so the active set is a bitmask.
+        struct Event {
+            int64_t t;
+            size_t loop;
+            bool begin;
+        };
+        std::vector<Event> events;
+        for (size_t i = 0; i < loops.size() && i < 64; ++i) {
+            for (auto& span : spans[i]) {
+                events.push_back({ span.beginNs, i, true });
+                events.push_back({ span.endNs, i, false });
+            }
+        }
+        std::sort(events.begin(), events.end(), [](const Event& a, const Event& b) {
+            return a.t != b.t ? a.t < b.t : a.begin < b.begin; // ends first
+        });
+        size_t n = std::min<size_t>(loops.size(), 64);
+        std::vector<double> pairNs(n * n, 0.0);
+        double concurrentNs = 0.0;
+        uint64_t active = 0;
+        int64_t last = from;
+        for (auto& e : events) {
+            int64_t dt = e.t - last;
+            if (dt > 0 && (active & (active - 1))) {
+                concurrentNs += dt;
+                for (size_t a = 0; a < n; ++a) {
+                    for (size_t b = a + 1; b < n; ++b) {
+                        if ((active >> a & 1) && (active >> b & 1))
+                            pairNs[a * n + b] += dt;
+                    }
+                }
+            }
+            last = e.t;
+            if (e.begin)
+                active |= uint64_t(1) << e.loop;
+            else
+                active &= ~(uint64_t(1) << e.loop);
+        }
+
+        w.raw("],\"overlap\":{\"concurrentMs\":");
+        w.number(concurrentNs / 1e6);
+        w.raw(",\"pairs\":[");
+        bool first = true;
+        for (size_t a = 0; a < n; ++a) {
+            for (size_t b = a + 1; b < n; ++b) {
+                w.raw(first ? "{\"a\":" : ",{\"a\":");
+                w.string(loops[a]->name());
+                w.raw(",\"b\":");
+                w.string(loops[b]->name());
+                w.raw(",\"overlapMs\":");
+                w.number(pairNs[a * n + b] / 1e6);
+                w.raw("}", 1);
+                first = false;
+            }
+        }
+        w.raw("]}}", 3);
+    }
+
+    static std::vector<FrameLoop*> loopList(ServerState& state)
+    {
+        std::shared_lock<std::shared_mutex> lock(state.loopsMutex);
+        std::vector<FrameLoop*> loops;
+        for (auto& loop : state.loops)
+            loops.push_back(loop.get());
+        return loops;
+    }
+
+    // /api/loops[?windowMs=N] and /api/loops/<name>/frames?since=N
+    static int handleLoops(struct mg_connection* conn, void* cbdata)
+    {
+        auto* req = mg_get_request_info(conn);
+        if (std::strcmp(req->request_method, "OPTIONS") == 0) {
+            sendCorsOptions(conn);
+            return 204;
+        }
+        auto& state = ServerAccess::state(static_cast<Server*>(cbdata));
+        auto loops = loopList(state);
+        int precision = queryPrecision(req, state);
+        std::string body;
+        JsonWriter w(body, precision);
+
+        const char* route = req->local_uri + state.prefix.size() + std::strlen("/api/loops");
+        if (*route == '\0' || std::strcmp(route, "/") == 0) {
+            uint64_t windowMs = std::clamp<uint64_t>(queryUInt(req, "windowMs", 1000), 1, 60000);
+            writeLoops(w, loops, static_cast<int64_t>(windowMs) * 1000000);
+            sendBody(conn, 200, body);
+            return 200;
+        }
+
+        const char* name = route + 1;
+        const char* slash = std::strchr(name, '/');
+        FrameLoop* loop = nullptr;
+        for (auto* l : loops) {
+            if (slash && l->name() == std::string(name, slash))
+                loop = l;
+        }
+        if (!loop || std::strcmp(slash, "/frames") != 0) {
+            sendJson(conn, 404, { { "error", loop ? "Unknown loop route" : "Loop not found" } });
+            return 404;
+        }
+
+        uint64_t since = queryUInt(req, "since", 0);
+        std::vector<LoopState::Span> spans;
+        uint64_t latest = 0;
+        uint64_t first = loopState(loop).copySince(since, spans, latest);
+        w.raw("{\"latest\":");
+        w.uint(latest);
+        w.raw(",\"first\":");
+        w.uint(first);
+        w.raw(",\"dropped\":");
+        w.uint(first - std::min(first, since + 1));
+        w.raw(",\"beginMs\":[");
+        for (size_t i = 0; i < spans.size(); ++i) {
+            if (i > 0)
+                w.raw(",", 1);
+            w.number(static_cast<double>(spans[i].beginNs) / 1e6);
+        }
+        w.raw("],\"durationMs\":[");
+        for (size_t i = 0; i < spans.size(); ++i) {
+            if (i > 0)
+                w.raw(",", 1);
+            w.number(static_cast<float>(static_cast<double>(spans[i].endNs - spans[i].beginNs) / 1e6));
+        }
+        w.raw("]}", 2);
+        sendBody(conn, 200, body);
+        return 200;
+    }
+
+    static constexpr size_t kJobGapsListed = 16; // longest idle gaps listed per frame
+    static constexpr int64_t kJobGapMinNs = 10000; // shorter idle stretches count as idle time, not gaps
+
+    // One execution of a job within a frame
+    struct JobRun {
+        uint64_t id;
+        int64_t spawnNs;
+        const char* name = nullptr;
+        int worker = -1;
+        int64_t startNs = -1;
+        int64_t endNs = -1; // frame end if it never finished
+        std::vector<size_t> prereqs = {};
+    };
+
+    struct JobFrame {
+        int64_t beginNs;
+        int64_t endNs;
+        bool complete = true; // false if a worker's ring no longer reaches back to the frame's start
+        std::vector<JobRun> runs = {};
+        size_t edges = 0;
+        size_t unfinished = 0;
+    };
+
+    // Replays every worker's events within the frame in time order. A job
+    // spawned before the frame began counts as spawned at its start; edges to
+    // prerequisites that ran before it are dropped.
+    static JobFrame collectJobFrame(const JobGraph* graph, const LoopState::Span& frame)
+    {
+        const auto& state = ServerAccess::jobGraph(graph);
+        JobFrame out { frame.beginNs, frame.endNs };
+
+        struct Tagged {
+            JobRing::Event event;
+            int worker;
+        };
+        std::vector<Tagged> events;
+        std::vector<JobRing::Event> buf;
+        for (int i = 0; i < graph->workers(); ++i) {
+            buf.clear();
+            bool whole = state.rings[i].copy(buf);
+            if (!whole && (buf.empty() || buf.front().timeNs > frame.beginNs))
+                out.complete = false;
+            for (auto& e : buf) {
+                if (e.timeNs >= frame.beginNs && e.timeNs <= frame.endNs)
+                    events.push_back({ e, i });
+            }
+        }
+        std::stable_sort(events.begin(), events.end(), [](const Tagged& a, const Tagged& b) {
+            return a.event.timeNs < b.event.timeNs;
+        });
+
+        std::unordered_map<uint64_t, size_t> current; // job id -> its latest run
+        auto open = [&](uint64_t id, int64_t spawnNs) {
+            out.runs.push_back({ id, spawnNs });
+            current[id] = out.runs.size() - 1;
+            return out.runs.size() - 1;
+        };
+        for (auto& [e, worker] : events) {
+            auto it = current.find(e.job);
+            size_t run = it != current.end() ? it->second : SIZE_MAX;
+            switch (e.kind) {
+            case JobRing::Spawn:
+                out.runs[open(e.job, e.timeNs)].name = reinterpret_cast<const char*>(e.arg);
+                break;
+            case JobRing::Depend: {
+                auto prereq = current.find(e.arg);
+                if (prereq == current.end() || e.arg == e.job)
+                    break;
+                size_t p = prereq->second;
+                if (run == SIZE_MAX)
+                    run = open(e.job, frame.beginNs);
+                out.runs[run].prereqs.push_back(p);
+                ++out.edges;
+                break;
+            }
+            case JobRing::Start:
+                if (run == SIZE_MAX || out.runs[run].startNs >= 0)
+                    run = open(e.job, frame.beginNs);
+                out.runs[run].startNs = e.timeNs;
+                out.runs[run].worker = worker;
+                break;
+            case JobRing::Finish:
+                if (run != SIZE_MAX && out.runs[run].startNs >= 0 && out.runs[run].endNs < 0)
+                    out.runs[run].endNs = e.timeNs;
+                break;
+            }
+        }
+        for (auto& r : out.runs) {
+            if (r.startNs >= 0 && r.endNs < 0) {
+                r.endNs = frame.endNs;
+                ++out.unfinished;
+            }
+        }
+        return out;
+    }
+
+    // Critical path (the chain of dependent jobs with the most work, which
+    // bounds the frame however many workers there are), per-worker
+    // utilization and the longest stretches a worker sat idle
+    static void writeJobFrame(JsonWriter& w, const JobGraph* graph, uint64_t number, uint64_t latest, const JobFrame& frame)
+    {
+        auto ms = [&](int64_t ns) { return static_cast<double>(ns) / 1e6; };
+        auto at = [&](int64_t ns) { return ms(ns - frame.beginNs); };
+        const auto& runs = frame.runs;
+        int64_t frameNs = std::max<int64_t>(frame.endNs - frame.beginNs, 1);
+
+        // Start order is topological: a job can't start before its
+        // prerequisites finish. Edges that say otherwise are ignored.
+        std::vector<size_t> order;
+        for (size_t i = 0; i < runs.size(); ++i) {
+            if (runs[i].startNs >= 0)
+                order.push_back(i);
+        }
+        std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return runs[a].startNs < runs[b].startNs; });
+        std::vector<size_t> rank(runs.size(), SIZE_MAX);
+        for (size_t k = 0; k < order.size(); ++k)
+            rank[order[k]] = k;
+
+        std::vector<int64_t> chain(runs.size(), 0); // work on the heaviest chain ending at each run
+        std::vector<size_t> via(runs.size(), SIZE_MAX);
+        std::vector<int64_t> ready(runs.size(), 0);
+        int64_t workNs = 0;
+        size_t last = SIZE_MAX;
+        for (size_t r : order) {
+            int64_t best = 0;
+            ready[r] = std::max(runs[r].spawnNs, frame.beginNs);
+            for (size_t p : runs[r].prereqs) {
+                if (rank[p] >= rank[r])
+                    continue;
+                ready[r] = std::max(ready[r], runs[p].endNs);
+                if (chain[p] > best) {
+                    best = chain[p];
+                    via[r] = p;
+                }
+            }
+            int64_t d = runs[r].endNs - runs[r].startNs;
+            chain[r] = best + d;
+            workNs += d;
+            if (last == SIZE_MAX || chain[r] > chain[last])
+                last = r;
+        }
+        std::vector<size_t> path;
+        for (size_t r = last; r != SIZE_MAX; r = via[r])
+            path.push_back(r);
+        std::reverse(path.begin(), path.end());
+        int64_t pathWaitNs = 0;
+        for (size_t r : path)
+            pathWaitNs += std::max<int64_t>(runs[r].startNs - ready[r], 0);
+
+        w.raw("{\"graph\":");
+        w.string(graph->name());
+        w.raw(",\"frame\":");
+        w.uint(number);
+        w.raw(",\"latest\":");
+        w.uint(latest);
+        w.raw(",\"beginMs\":");
+        w.number(ms(frame.beginNs));
+        w.raw(",\"durationMs\":");
+        w.number(ms(frameNs));
+        w.raw(",\"complete\":");
+        w.raw(frame.complete ? "true" : "false");
+        w.raw(",\"jobs\":");
+        w.uint(order.size());
+        w.raw(",\"pending\":");
+        w.uint(runs.size() - order.size());
+        w.raw(",\"unfinished\":");
+        w.uint(frame.unfinished);
+        w.raw(",\"edges\":");
+        w.uint(frame.edges);
+        w.raw(",\"workMs\":");
+        w.number(ms(workNs));
+
+        w.raw(",\"criticalPath\":{\"durationMs\":");
+        w.number(ms(last == SIZE_MAX ? 0 : chain[last]));
+        w.raw(",\"waitMs\":");
+        w.number(ms(pathWaitNs));
+        w.raw(",\"parallelism\":");
+        w.number(last == SIZE_MAX || chain[last] == 0 ? 0.0 : static_cast<double>(workNs) / static_cast<double>(chain[last]));
+        w.raw(",\"jobs\":[");
+        for (size_t k = 0; k < path.size(); ++k) {
+            const auto& r = runs[path[k]];
+            w.raw(k ? ",{\"id\":\"" : "{\"id\":\"");
+            w.uint(r.id);
+            w.raw("\",\"name\":");
+            if (r.name)
+                w.string(r.name, std::strlen(r.name));
+            else
+                w.raw("null", 4);
+            w.raw(",\"worker\":");
+            w.integer(r.worker);
+            w.raw(",\"startMs\":");
+            w.number(at(r.startNs));
+            w.raw(",\"durationMs\":");
+            w.number(ms(r.endNs - r.startNs));
+            w.raw(",\"waitMs\":");
+            w.number(ms(std::max<int64_t>(r.startNs - ready[path[k]], 0)));
+            w.raw("}", 1);
+        }
+
+        // Busy time is the union of a worker's runs, since a worker that
+        // waits on a job may run others inside it
+        struct Gap {
+            int worker;
+            int64_t beginNs;
+            int64_t ns;
+        };
+        std::vector<Gap> gaps;
+        std::vector<std::vector<std::pair<int64_t, int64_t>>> busy(static_cast<size_t>(graph->workers()));
+        for (size_t r : order)
+            busy[static_cast<size_t>(runs[r].worker)].push_back({ runs[r].startNs, runs[r].endNs });
+        int64_t busyTotalNs = 0;
+        w.raw("]},\"workers\":[");
+        for (int i = 0; i < graph->workers(); ++i) {
+            auto& spans = busy[static_cast<size_t>(i)];
+            std::sort(spans.begin(), spans.end());
+            int64_t busyNs = 0, longestNs = 0, cursor = frame.beginNs;
+            size_t count = 0;
+            auto idle = [&](int64_t until) {
+                int64_t ns = until - cursor;
+                if (ns < kJobGapMinNs)
+                    return;
+                gaps.push_back({ i, cursor, ns });
+                longestNs = std::max(longestNs, ns);
+                ++count;
+            };
+            for (auto& [b, e] : spans) {
+                if (e <= cursor)
+                    continue;
+                idle(std::max(b, cursor));
+                busyNs += e - std::max(b, cursor);
+                cursor = e;
+            }
+            idle(frame.endNs);
+            busyTotalNs += busyNs;
+
+            w.raw(i ? ",{\"worker\":" : "{\"worker\":");
+            w.integer(i);
+            w.raw(",\"jobs\":");
+            w.uint(spans.size());
+            w.raw(",\"busyMs\":");
+            w.number(ms(busyNs));
+            w.raw(",\"utilization\":");
+            w.number(static_cast<double>(busyNs) / static_cast<double>(frameNs));
+            w.raw(",\"gaps\":");
+            w.uint(count);
+            w.raw(",\"longestGapMs\":");
+            w.number(ms(longestNs));
+            w.raw("}", 1);
+        }
+        w.raw("],\"utilization\":");
+        w.number(static_cast<double>(busyTotalNs) / static_cast<double>(frameNs * graph->workers()));
+
+        size_t listed = std::min(gaps.size(), kJobGapsListed);
+        std::partial_sort(gaps.begin(), gaps.begin() + static_cast<std::ptrdiff_t>(listed), gaps.end(),
+            [](const Gap& a, const Gap& b) { return a.ns > b.ns; });
+        w.raw(",\"gaps\":[");
+        for (size_t k = 0; k < listed; ++k) {
+            w.raw(k ? ",{\"worker\":" : "{\"worker\":");
+            w.integer(gaps[k].worker);
+            w.raw(",\"startMs\":");
+            w.number(at(gaps[k].beginNs));
+            w.raw(",\"durationMs\":");
+            w.number(ms(gaps[k].ns));
+            w.raw("}", 1);
+        }
+        w.raw("]}", 2);
+    }
+
+    static std::vector<JobGraph*> jobGraphList(ServerState& state)
+    {
+        std::shared_lock<std::shared_mutex> lock(state.jobGraphsMutex);
+        std::vector<JobGraph*> graphs;
+        for (auto& graph : state.jobGraphs)
+            graphs.push_back(graph.get());
+        return graphs;
+    }
+
+    // /api/jobs and /api/jobs/<name>[?frame=N]
+    static int handleJobs(struct mg_connection* conn, void* cbdata)
+    {
+        auto* req = mg_get_request_info(conn);
+        if (std::strcmp(req->request_method, "OPTIONS") == 0) {
+            sendCorsOptions(conn);
+            return 204;
+        }
+        auto& state = ServerAccess::state(static_cast<Server*>(cbdata));
+        auto graphs = jobGraphList(state);
+        std::string body;
+        JsonWriter w(body, queryPrecision(req, state));
+        std::vector<LoopState::Span> frames;
+        uint64_t latest = 0;
+
+        const char* route = req->local_uri + state.prefix.size() + std::strlen("/api/jobs");
+        if (*route == '\0' || std::strcmp(route, "/") == 0) {
+            w.raw("{\"graphs\":[");
+            for (size_t i = 0; i < graphs.size(); ++i) {
+                const auto& ring = ServerAccess::jobGraph(graphs[i]).frames;
+                uint64_t head = ring.head.load(std::memory_order_acquire);
+                ring.copySince(head > 0 ? head - 1 : 0, frames, latest);
+                w.raw(i ? ",{\"name\":" : "{\"name\":");
+                w.string(graphs[i]->name());
+                w.raw(",\"workers\":");
+                w.integer(graphs[i]->workers());
+                w.raw(",\"latest\":");
+                w.uint(latest);
+                w.raw(",\"lastFrameMs\":");
+                if (frames.empty())
+                    w.raw("null", 4);
+                else
+                    w.number(static_cast<double>(frames.back().endNs - frames.back().beginNs) / 1e6);
+                w.raw("}", 1);
+            }
+            w.raw("]}", 2);
+            sendBody(conn, 200, body);
+            return 200;
+        }
+
+        JobGraph* graph = nullptr;
+        for (auto* g : graphs) {
+            if (g->name() == route + 1)
+                graph = g;
+        }
+        if (!graph) {
+            sendJson(conn, 404, { { "error", "Job graph not found" } });
+            return 404;
+        }
+
+        const auto& ring = ServerAccess::jobGraph(graph).frames;
+        uint64_t number = queryUInt(req, "frame", ring.head.load(std::memory_order_acquire));
+        uint64_t first = number > 0 ? ring.copySince(number - 1, frames, latest) : 0;
+        if (first != number || frames.empty()) {
+            sendJson(conn, 404, { { "error", "Frame not available" } });
+            return 404;
+        }
+        writeJobFrame(w, graph, number, latest, collectJobFrame(graph, frames.front()));
+        sendBody(conn, 200, body);
+        return 200;
+    }
+
+    // Latest value, measured rate and interval jitter per gauge, from the
+    // samples still in each ring
+    static void writeGauges(JsonWriter& w, const std::vector<std::shared_ptr<GaugeState>>& gauges)
+    {
+        std::vector<GaugeState::Sample> samples;
+        w.raw("{\"gauges\":[");
+        for (size_t i = 0; i < gauges.size(); ++i) {
+            const auto& g = *gauges[i];
+            uint64_t latest = 0;
+            g.copySince(0, samples, latest);
+
+            // Interval deviation from the period, as a standard deviation
+            double rateHz = 0.0, jitterNs = 0.0;
+            if (samples.size() > 1) {
+                double spanNs = static_cast<double>(samples.back().timeNs - samples.front().timeNs);
+                rateHz = (samples.size() - 1) * 1e9 / spanNs;
+                double sq = 0.0;
+                for (size_t k = 1; k < samples.size(); ++k) {
+                    double d = static_cast<double>(samples[k].timeNs - samples[k - 1].timeNs - g.periodNs);
+                    sq += d * d;
+                }
+                jitterNs = std::sqrt(sq / (samples.size() - 1));
+            }
+
+            w.raw(i ? ",{\"name\":" : "{\"name\":");
+            w.string(g.name);
+            w.raw(",\"targetHz\":");
+            w.number(g.rateHz);
+            w.raw(",\"latest\":");
+            w.uint(latest);
+            w.raw(",\"value\":");
+            if (samples.empty())
+                w.raw("null", 4);
+            else
+                w.number(samples.back().value);
+            w.raw(",\"rateHz\":");
+            w.number(rateHz);
+            w.raw(",\"jitterMs\":");
+            w.number(jitterNs / 1e6);
+            w.raw(",\"skipped\":");
+            w.uint(g.skipped.load(std::memory_order_relaxed));
+            w.raw("}", 1);
+        }
+        w.raw("]}", 2);
+    }
+
+    // /api/gauges and /api/gauges/<name>?since=N
+    static int handleGauges(struct mg_connection* conn, void* cbdata)
+    {
+        auto* req = mg_get_request_info(conn);
+        if (std::strcmp(req->request_method, "OPTIONS") == 0) {
+            sendCorsOptions(conn);
+            return 204;
+        }
+        auto& state = ServerAccess::state(static_cast<Server*>(cbdata));
+        auto gauges = state.gauges.list();
+        std::string body;
+        JsonWriter w(body, queryPrecision(req, state));
+
+        const char* route = req->local_uri + state.prefix.size() + std::strlen("/api/gauges");
+        if (*route == '\0' || std::strcmp(route, "/") == 0) {
+            writeGauges(w, gauges);
+            sendBody(conn, 200, body);
+            return 200;
+        }
+
+        auto it = std::find_if(gauges.begin(), gauges.end(), [&](auto& g) { return g->name == route + 1; });
+        if (it == gauges.end()) {
+            sendJson(conn, 404, { { "error", "Gauge not found" } });
             return 404;
         }
 
-        auto* server = static_cast<Server*>(cbdata);
-        auto entity = ServerAccess::getEntity(server, id);
-        if (!entity) {
-            sendJson(conn, 404, { { "error", "Entity not found" } });
-            return 404;
+        uint64_t since = queryUInt(req, "since", 0);
+        std::vector<GaugeState::Sample> samples;
+        uint64_t latest = 0;
+        uint64_t first = (*it)->copySince(since, samples, latest);
+        w.raw("{\"latest\":");
+        w.uint(latest);
+        w.raw(",\"first\":");
+        w.uint(first);
+        w.raw(",\"dropped\":");
+        w.uint(first - std::min(first, since + 1));
+        w.raw(",\"timeMs\":[");
+        for (size_t i = 0; i < samples.size(); ++i) {
+            if (i > 0)
+                w.raw(",", 1);
+            w.number(static_cast<double>(samples[i].timeNs) / 1e6);
+        }
+        w.raw("],\"values\":[");
+        for (size_t i = 0; i < samples.size(); ++i) {
+            if (i > 0)
+                w.raw(",", 1);
+            w.number(samples[i].value);
+        }
+        w.raw("]}", 2);
+        sendBody(conn, 200, body);
+        return 200;
+    }
+
+    // ---------------------------------------------------------------------------
+    // Copy-on-write snapshot export (Linux): the game thread forks at a frame
+    // boundary; the child serializes the frozen world into a pipe and exits
+    // ---------------------------------------------------------------------------
+
+#if defined(__linux__)
+    static bool writeAll(int fd, const std::string& data)
+    {
+        const char* p = data.data();
+        size_t left = data.size();
+        while (left > 0) {
+            ssize_t n = ::write(fd, p, left);
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n <= 0)
+                return false;
+            p += n;
+            left -= static_cast<size_t>(n);
+        }
+        return true;
+    }
+
+    // Runs in the forked child, which only has the game thread: user callbacks
+    // must not wait on locks other threads might have held at the fork.
+    [[noreturn]] static void runExportChild(Server* server, int fd, int precision)
+    {
+        std::string out;
+        JsonWriter w(out, precision);
+        auto nodes = ServerAccess::getScene(server);
+        SceneSerializer scene;
+        auto tree = scene.serialize(nodes);
+        w.raw("\"scene\":");
+        w.raw(tree->data(), tree->size());
+        w.raw(",\"entities\":{");
+        bool first = true;
+        for (auto& node : nodes) {
+            auto entity = ServerAccess::getEntity(server, node.id);
+            if (!entity)
+                continue;
+            w.raw(first ? "\"" : ",\"", first ? 1 : 2);
+            w.uint(node.id);
+            w.raw("\":", 2);
+            writeEntity(w, *entity);
+            first = false;
+            if (out.size() >= 64 * 1024) {
+                if (!writeAll(fd, out))
+                    ::_exit(1);
+                out.clear();
+            }
+        }
+        w.raw("}", 1);
+        ::_exit(writeAll(fd, out) ? 0 : 1);
+    }
+
+    // Game thread, from recordFrame(); the only cost without a pending
+    // export is the atomic load in the caller
+    static void forkExport(Server* server, ExportSlot& slot, uint64_t frame)
+    {
+        if (!slot.pending.exchange(false, std::memory_order_acquire))
+            return;
+
+        int fds[2] = { -1, -1 };
+        pid_t pid = -1;
+        auto t0 = std::chrono::steady_clock::now();
+        if (::pipe2(fds, O_CLOEXEC) == 0) {
+            pid = ::fork();
+            if (pid == 0) {
+                ::close(fds[0]);
+                runExportChild(server, fds[1], slot.precision);
+            }
+            ::close(fds[1]);
+            if (pid < 0) {
+                ::close(fds[0]);
+                fds[0] = -1;
+            }
+        }
+        std::chrono::duration<double, std::milli> hitch = std::chrono::steady_clock::now() - t0;
+
+        {
+            std::lock_guard<std::mutex> lock(slot.mutex);
+            slot.fd = fds[0];
+            slot.pid = pid;
+            slot.forkMs = hitch.count();
+            slot.frame = frame;
+            slot.done = true;
+        }
+        slot.cv.notify_one();
+    }
+
+    // Relays the child's output as a chunked body. A child that fails or
+    // stalls leaves the body unterminated, so clients see a broken transfer.
+    static int streamExport(struct mg_connection* conn, const ExportSlot& slot)
+    {
+        mg_printf(conn,
+            "HTTP/1.1 200 OK\r\n"
+            "Content-Type: application/json\r\n"
+            "Access-Control-Allow-Origin: *\r\n"
+            "Access-Control-Expose-Headers: X-Reflector-Fork-Ms\r\n"
+            "X-Reflector-Fork-Ms: %.3f\r\n"
+            "%s"
+            "Transfer-Encoding: chunked\r\n"
+            "Connection: close\r\n"
+            "\r\n",
+            slot.forkMs, serverTimingHeaders().c_str());
+
+        std::string head;
+        JsonWriter w(head);
+        w.raw("{\"frame\":");
+        w.uint(slot.frame);
+        w.raw(",\"forkMs\":");
+        w.number(slot.forkMs);
+        w.raw(",", 1);
+        bool ok = mg_send_chunk(conn, head.data(), static_cast<unsigned>(head.size())) > 0;
+
+        char buf[64 * 1024];
+        bool eof = false;
+        while (ok) {
+            pollfd pfd = { slot.fd, POLLIN, 0 };
+            int ready = ::poll(&pfd, 1, 30000);
+            if (ready < 0 && errno == EINTR)
+                continue;
+            if (ready <= 0)
+                break; // stalled child
+            ssize_t n = ::read(slot.fd, buf, sizeof(buf));
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n <= 0) {
+                eof = n == 0;
+                break;
+            }
+            ok = mg_send_chunk(conn, buf, static_cast<unsigned>(n)) > 0;
+        }
+        ::close(slot.fd);
+
+        if (!eof)
+            ::kill(slot.pid, SIGKILL);
+        int status = 0;
+        while (::waitpid(slot.pid, &status, 0) < 0 && errno == EINTR) { }
+        bool complete = ok && eof && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+        if (complete) {
+            mg_send_chunk(conn, "}", 1);
+            mg_send_chunk(conn, "", 0);
+        }
+
+        std::fprintf(stdout, "[reflector] Export at frame %llu: fork hitch %.2f ms%s\n",
+            static_cast<unsigned long long>(slot.frame), slot.forkMs, complete ? "" : " (incomplete)");
+        return complete ? 200 : 500;
+    }
+#endif
+
+    static int handleExport(struct mg_connection* conn, void* cbdata)
+    {
+        auto* req = mg_get_request_info(conn);
+        if (std::strcmp(req->request_method, "OPTIONS") == 0) {
+            sendCorsOptions(conn);
+            return 204;
+        }
+#if defined(__linux__)
+        auto& state = ServerAccess::state(static_cast<Server*>(cbdata));
+        auto& slot = state.exports;
+        // Waiting for an export in progress would hold a worker for all of it
+        std::unique_lock<std::mutex> busy(slot.busy, std::try_to_lock);
+        if (!busy.owns_lock()) {
+            sendJson(conn, 409, { { "error", "An export is already in progress" } });
+            return 409;
+        }
+        {
+            PhaseTimer timer(Phase::Wait);
+            std::unique_lock<std::mutex> lock(slot.mutex);
+            slot.done = false;
+            slot.precision = queryPrecision(req, state);
+            slot.pending.store(true, std::memory_order_release);
+            if (!slot.cv.wait_for(lock, std::chrono::seconds(5), [&] { return slot.done; })) {
+                // Withdraw the request unless the game thread claimed it meanwhile
+                if (slot.pending.exchange(false)) {
+                    sendJson(conn, 503, { { "error", "No frame recorded; exports fork inside recordFrame()" } });
+                    return 503;
+                }
+                slot.cv.wait(lock, [&] { return slot.done; });
+            }
+        }
+        if (slot.fd < 0) {
+            sendJson(conn, 500, { { "error", "fork() failed" } });
+            return 500;
+        }
+        return streamExport(conn, slot);
+#else
+        (void)cbdata;
+        sendJson(conn, 501, { { "error", "Snapshot export requires fork() (Linux only)" } });
+        return 501;
+#endif
+    }
+
+    static int handleMounts(struct mg_connection* conn, void* cbdata)
+    {
+        auto* req = mg_get_request_info(conn);
+        if (std::strcmp(req->request_method, "OPTIONS") == 0) {
+            sendCorsOptions(conn);
+            return 204;
+        }
+        auto* state = static_cast<HostState*>(cbdata);
+        std::string body;
+        JsonWriter w(body);
+        w.raw("{\"mounts\":[");
+        {
+            std::lock_guard<std::mutex> lock(state->mutex);
+            bool first = true;
+            for (auto& [prefix, server] : state->mounts) {
+                w.raw(first ? "{\"prefix\":" : ",{\"prefix\":");
+                w.string(prefix);
+                w.raw("}", 1);
+                first = false;
+            }
+        }
+        w.raw("]}", 2);
+        sendBody(conn, 200, body);
+        return 200;
+    }
+
+    // ---------------------------------------------------------------------------
+    // Custom routes (Server::route)
+    // ---------------------------------------------------------------------------
+
+    static constexpr size_t kRouteCacheEntries = 64; // cached URLs per route, LRU
+
+    // One run of a handler that concurrent requests for the same URL share
+    struct RouteFlight {
+        std::mutex mutex;
+        std::condition_variable cv;
+        bool done = false;
+        Reply reply { 500, nullptr, {} };
+    };
+
+    // A route's replies by URL, each at the generation it was made at, least
+    // recently used evicted first. Guarded by CustomRoute::mutex.
+    class RouteCache {
+    public:
+        std::optional<Reply> get(const std::string& url, uint64_t version)
+        {
+            auto it = index_.find(url);
+            if (it == index_.end() || it->second->reply.version != version)
+                return std::nullopt;
+            lru_.splice(lru_.begin(), lru_, it->second);
+            return it->second->reply;
+        }
+
+        void put(const std::string& url, Reply reply)
+        {
+            auto it = index_.find(url);
+            if (it != index_.end()) {
+                it->second->reply = std::move(reply);
+                lru_.splice(lru_.begin(), lru_, it->second);
+                return;
+            }
+            lru_.push_front({ url, std::move(reply) });
+            index_[url] = lru_.begin();
+            if (lru_.size() > kRouteCacheEntries) {
+                index_.erase(lru_.back().url);
+                lru_.pop_back();
+            }
+        }
+
+    private:
+        struct Entry {
+            std::string url;
+            Reply reply;
+        };
+
+        std::list<Entry> lru_;
+        std::unordered_map<std::string, std::list<Entry>::iterator> index_;
+    };
+
+    struct CustomRoute {
+        Server* server;
+        std::string path;
+        RouteHandler handler;
+        AsyncRouteHandler asyncHandler; // set instead of `handler` by routeAsync
+        RoutePolicy policy;
+
+        std::mutex mutex; // guards the cache and flights
+        RouteCache cache;
+        std::unordered_map<std::string, std::shared_ptr<RouteFlight>> flights; // URL -> run in progress
+    };
+
+    static void runMainThreadJobs(MainThreadQueue& queue)
+    {
+        std::vector<MainThreadJob*> jobs;
+        std::vector<std::function<void()>> posted;
+        {
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            jobs.swap(queue.jobs);
+            posted.swap(queue.posted);
+            queue.pending.store(false, std::memory_order_relaxed);
+        }
+        for (auto& job : posted)
+            job();
+        for (auto* job : jobs)
+            job->run();
+        {
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            for (auto* job : jobs)
+                job->done = true;
+        }
+        queue.cv.notify_all();
+    }
+
+    static void postMainThreadJob(MainThreadQueue& queue, std::function<void()> job)
+    {
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.posted.push_back(std::move(job));
+        queue.pending.store(true, std::memory_order_release);
+    }
+
+    static void backgroundLoop(BackgroundPool& pool)
+    {
+        std::unique_lock<std::mutex> lock(pool.mutex);
+        for (;;) {
+            pool.cv.wait(lock, [&] { return pool.stopping || !pool.jobs.empty(); });
+            if (pool.stopping)
+                return;
+            auto job = std::move(pool.jobs.front());
+            pool.jobs.pop_front();
+            lock.unlock();
+            job();
+            job = nullptr; // drop captures before retaking the lock
+            lock.lock();
+        }
+    }
+
+    static void postBackgroundJob(BackgroundPool& pool, std::function<void()> job)
+    {
+        {
+            std::lock_guard<std::mutex> lock(pool.mutex);
+            if (pool.stopping)
+                return;
+            pool.jobs.push_back(std::move(job));
+            for (int i = static_cast<int>(pool.threads.size()); i < BackgroundPool::kThreads; ++i)
+                pool.threads.emplace_back([&pool] { backgroundLoop(pool); });
+        }
+        pool.cv.notify_one();
+    }
+
+    // Joins the threads and drops queued jobs (outside the lock: dropping a
+    // suspended coroutine or the last responder copy answers its request)
+    static void stopBackground(BackgroundPool& pool)
+    {
+        std::deque<std::function<void()>> dropped;
+        {
+            std::lock_guard<std::mutex> lock(pool.mutex);
+            pool.stopping = true;
+            dropped.swap(pool.jobs);
+        }
+        pool.cv.notify_all();
+        for (auto& thread : pool.threads)
+            thread.join();
+        pool.threads.clear();
+    }
+
+    static constexpr int kAsyncRouteTimeoutMs = 30000;
+
+    // One request to an async route. The RouteRequest handed to the handler
+    // points into `path` and `query`, which the responders keep alive.
+    struct AsyncCall {
+        std::string path;
+        std::string query;
+        int precision = -1;
+
+        std::mutex mutex;
+        std::condition_variable cv;
+        bool done = false; // answered, or given up on by the waiting worker
+        int status = 500;
+        std::string body;
+    };
+
+    // First answer wins; false if the request was already answered
+    static bool completeAsync(AsyncCall& call, int status, std::string body)
+    {
+        {
+            std::lock_guard<std::mutex> lock(call.mutex);
+            if (call.done)
+                return false;
+            call.done = true;
+            call.status = status;
+            call.body = std::move(body);
+        }
+        call.cv.notify_all();
+        return true;
+    }
+
+    static std::string errorBody(const std::string& message)
+    {
+        return nlohmann::json { { "error", message } }.dump();
+    }
+
+    // Shared by the copies of one RouteResponder
+    struct AsyncToken {
+        explicit AsyncToken(std::shared_ptr<AsyncCall> c)
+            : call(std::move(c))
+        {
+        }
+        AsyncToken(const AsyncToken&) = delete;
+        AsyncToken& operator=(const AsyncToken&) = delete;
+        ~AsyncToken() { completeAsync(*call, 500, errorBody("Handler dropped the request")); }
+
+        std::shared_ptr<AsyncCall> call;
+    };
+
+    // Starts the async handler (on the game thread if the policy says so)
+    // and parks this worker until it answers, times out or the server stops
+    static int runAsyncRoute(ServerState& state, CustomRoute& route, const RouteRequest& request, int precision, std::string& buffer)
+    {
+        if (state.parked.fetch_add(1) >= state.maxParked.load()) {
+            state.parked.fetch_sub(1);
+            buffer = errorBody("Too many waiting requests");
+            return 503;
+        }
+
+        auto call = std::make_shared<AsyncCall>();
+        call->path = request.path;
+        call->query = request.query;
+        call->precision = precision;
+        auto start = [&route, call] {
+            PhaseTimer timer(Phase::App);
+            RouteRequest req;
+            req.path = call->path;
+            req.query = call->query;
+            route.asyncHandler(req, ServerAccess::responder(std::make_shared<AsyncToken>(call)));
+        };
+        if (route.policy.mainThread)
+            postMainThreadJob(state.mainThread, start);
+        else
+            start();
+
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(kAsyncRouteTimeoutMs);
+        std::optional<PhaseTimer> timer(std::in_place, Phase::Wait);
+        std::unique_lock<std::mutex> lock(call->mutex);
+        for (;;) {
+            auto now = std::chrono::steady_clock::now();
+            if (call->done || now >= deadline || state.closing.load())
+                break;
+            call->cv.wait_until(lock, std::min(deadline, now + std::chrono::milliseconds(kMaxProbeMs)));
+        }
+        timer.reset();
+        int status = 503;
+        if (call->done) {
+            status = call->status;
+            buffer.swap(call->body);
+        } else {
+            call->done = true;
+            buffer = errorBody(state.closing.load() ? "Server stopping" : "Handler timed out");
+        }
+        lock.unlock();
+        state.parked.fetch_sub(1);
+        return status;
+    }
+
+    // Runs the handler into `buffer` (on the game thread if the policy says
+    // so) and returns its status
+    static int runRoute(ServerState& state, CustomRoute& route, const RouteRequest& request, int precision, std::string& buffer)
+    {
+        if (route.asyncHandler)
+            return runAsyncRoute(state, route, request, precision, buffer);
+
+        int status = 500;
+        auto run = [&] {
+            PhaseTimer timer(Phase::App);
+            buffer.clear();
+            JsonOut out = ServerAccess::jsonOut(buffer, precision);
+            status = route.handler(request, out);
+            if (ServerAccess::tooDeep(out)) {
+                buffer = errorBody("Response nested deeper than 64 levels");
+                status = 500;
+            }
+        };
+        if (!route.policy.mainThread) {
+            run();
+            return status;
+        }
+
+        auto& queue = state.mainThread;
+        MainThreadJob job { run };
+        PhaseTimer timer(Phase::Wait);
+        std::unique_lock<std::mutex> lock(queue.mutex);
+        queue.jobs.push_back(&job);
+        queue.pending.store(true, std::memory_order_release);
+        queue.cv.wait_for(lock, std::chrono::seconds(5), [&] { return job.done || state.closing.load(); });
+        if (!job.done) {
+            // Withdraw the job unless the game thread claimed it meanwhile
+            auto it = std::find(queue.jobs.begin(), queue.jobs.end(), &job);
+            if (it != queue.jobs.end()) {
+                queue.jobs.erase(it);
+                buffer = nlohmann::json { { "error", "No frame recorded; main-thread routes run inside recordFrame()" } }.dump();
+                return 503;
+            }
+            queue.cv.wait(lock, [&] { return job.done; });
+        }
+        return status;
+    }
+
+    static int handleCustom(struct mg_connection* conn, void* cbdata)
+    {
+        auto* req = mg_get_request_info(conn);
+        if (std::strcmp(req->request_method, "OPTIONS") == 0) {
+            sendCorsOptions(conn);
+            return 204;
+        }
+        if (std::strcmp(req->request_method, "GET") != 0) {
+            sendJson(conn, 405, { { "error", "Use GET" } });
+            return 405;
+        }
+
+        auto& route = *static_cast<CustomRoute*>(cbdata);
+        auto& state = ServerAccess::state(route.server);
+        state.active.fetch_add(1, std::memory_order_relaxed);
+        beginRequestTiming();
+
+        RouteRequest request;
+        request.path = req->local_uri + state.prefix.size();
+        request.query = req->query_string ? req->query_string : "";
+        int precision = queryPrecision(req, state);
+
+        // The handler writes into this worker's buffer, which keeps its
+        // capacity between requests
+        thread_local std::string buffer;
+
+        // Plain route: no copy of the body at all
+        const auto& policy = route.policy;
+        if (!policy.generation && !policy.singleFlight) {
+            int status = runRoute(state, route, request, precision, buffer);
+            sendBody(conn, status, buffer);
+            endRequestTiming();
+            state.active.fetch_sub(1, std::memory_order_relaxed);
+            return status;
+        }
+
+        std::string url(request.path);
+        url.append("?").append(request.query);
+        const char* ifNoneMatch = mg_get_header(conn, "If-None-Match");
+        std::optional<uint64_t> generation;
+        std::string etag;
+        if (policy.generation) {
+            generation = policy.generation();
+            etag = "\"g" + std::to_string(*generation) + "\"";
+        }
+
+        std::shared_ptr<RouteFlight> flight;
+        bool leader = true;
+        Reply reply { 500, nullptr, {} };
+        bool cached = false;
+        {
+            std::lock_guard<std::mutex> lock(route.mutex);
+            if (generation) {
+                if (auto hit = route.cache.get(url, *generation)) {
+                    reply = std::move(*hit);
+                    cached = true;
+                }
+            }
+            if (!cached && policy.singleFlight) {
+                auto& slot = route.flights[url];
+                leader = !slot;
+                if (leader)
+                    slot = std::make_shared<RouteFlight>();
+                flight = slot;
+            }
+        }
+
+        if (!cached && !leader) {
+            PhaseTimer timer(Phase::Wait);
+            std::unique_lock<std::mutex> lock(flight->mutex);
+            flight->cv.wait(lock, [&] { return flight->done; });
+            reply = flight->reply;
+        } else if (!cached) {
+            int status = runRoute(state, route, request, precision, buffer);
+            reply = { status, std::make_shared<const std::string>(buffer), {} };
+            if (generation && status == 200) {
+                reply.etag = etag;
+                reply.version = generation;
+            }
+            {
+                std::lock_guard<std::mutex> lock(route.mutex);
+                if (reply.version)
+                    route.cache.put(url, reply);
+                if (flight)
+                    route.flights.erase(url);
+            }
+            if (flight) {
+                {
+                    std::lock_guard<std::mutex> lock(flight->mutex);
+                    flight->reply = reply;
+                    flight->done = true;
+                }
+                flight->cv.notify_all();
+            }
+        }
+
+        if (!reply.etag.empty() && etagMatches(ifNoneMatch, reply.etag))
+            reply = { 304, nullptr, reply.etag };
+        int status = sendReply(conn, reply);
+        endRequestTiming();
+        state.active.fetch_sub(1, std::memory_order_relaxed);
+        return status;
+    }
+
+    // Times a handler's request for its Server-Timing header
+    template <mg_request_handler Handler>
+    static int timed(struct mg_connection* conn, void* cbdata)
+    {
+        beginRequestTiming();
+        int status = Handler(conn, cbdata);
+        endRequestTiming();
+        return status;
+    }
+
+    // Keeps ServerState::active up to date around a Server's handler (timed)
+    template <mg_request_handler Handler>
+    static int counted(struct mg_connection* conn, void* cbdata)
+    {
+        auto& state = ServerAccess::state(static_cast<Server*>(cbdata));
+        state.active.fetch_add(1, std::memory_order_relaxed);
+        int status = timed<Handler>(conn, cbdata);
+        state.active.fetch_sub(1, std::memory_order_relaxed);
+        return status;
+    }
+
+    struct Route {
+        const char* path;
+        mg_request_handler handler;
+    };
+
+    static const Route kRoutes[] = {
+        { "/api/perf", counted<handlePerf> },
+        { "/api/perf/frames", counted<handlePerfFrames> },
+        { "/api/perf/pacing", counted<handlePacing> },
+        { "/api/scene", counted<handleScene> },
+        { "/api/entity/", counted<handleEntity> },
+        { "/api/merkle", counted<handleMerkle> },
+        { "/api/worlds", counted<handleWorlds> },
+        { "/api/w/", counted<handleWorld> },
+        { "/api/export", counted<handleExport> },
+        { "/api/loops", counted<handleLoops> },
+        { "/api/jobs", counted<handleJobs> },
+        { "/api/gauges", counted<handleGauges> },
+        { "/api/batch", counted<handleBatch> },
+    };
+
+    // Whether CivetWeb could hand requests for one handler path to the
+    // other: it matches a handler at its exact path and at any "path/..."
+    // below it, whichever was registered first, so two paths clash if they
+    // are equal or one extends the other past a '/'. A trailing '/' (as in
+    // "/api/entity/") makes no difference.
+    static bool routesOverlap(std::string_view a, std::string_view b)
+    {
+        auto trim = [](std::string_view p) { return p.size() > 1 && p.back() == '/' ? p.substr(0, p.size() - 1) : p; };
+        a = trim(a);
+        b = trim(b);
+        if (a.size() > b.size())
+            std::swap(a, b);
+        return b.compare(0, a.size(), a) == 0 && (b.size() == a.size() || b[a.size()] == '/');
+    }
+
+    // Paths a custom route may not overlap: the built-in API, plus the one
+    // a Host serves next to the servers mounted at ""
+    static bool reservedRoute(std::string_view path)
+    {
+        for (auto& builtin : kRoutes) {
+            if (routesOverlap(path, builtin.path))
+                return true;
         }
+        return routesOverlap(path, "/api/mounts");
+    }
 
-        sendJson(conn, 200, entityToJson(*entity));
-        return 200;
+    // Registers (or, with `serve` false, removes) the server's API, custom
+    // routes included, under `prefix`
+    static void setRoutes(mg_context* ctx, const std::string& prefix, Server* server, bool serve = true)
+    {
+        for (auto& route : kRoutes)
+            mg_set_request_handler(ctx, (prefix + route.path).c_str(), serve ? route.handler : nullptr, server);
+        auto& state = ServerAccess::state(server);
+        std::lock_guard<std::mutex> lock(state.routesMutex);
+        for (auto& route : state.routes)
+            mg_set_request_handler(ctx, (prefix + route->path).c_str(), serve ? handleCustom : nullptr, route.get());
     }
 
 } // namespace detail
@@ -364,19 +4787,44 @@ namespace detail {
 // Server implementation
 // ---------------------------------------------------------------------------
 
+World::World()
+    : state_(std::make_unique<detail::WorldState>())
+{
+}
+
+World::~World() = default;
+
+void World::recordFrame(float frameTimeMs)
+{
+    state_->frames.record(frameTimeMs);
+    state_->wake();
+}
+
+void World::mark(const std::string& name)
+{
+    state_->frames.mark(name);
+}
+
+void World::setTargetFrameRate(float hz)
+{
+    state_->frames.setTargetRate(hz);
+}
+
 Server::Server(int port)
     : port_(port)
+    , state_(std::make_unique<detail::ServerState>())
 {
 }
 
 Server::~Server()
 {
     stop();
+    detail::stopBackground(state_->background);
 }
 
 void Server::start()
 {
-    if (ctx_)
+    if (ctx_ || host_)
         return;
 
     mg_init_library(0);
@@ -386,7 +4834,7 @@ void Server::start()
         "listening_ports",
         portStr.c_str(),
         "num_threads",
-        "2",
+        "6",
         nullptr,
     };
 
@@ -398,20 +4846,558 @@ void Server::start()
     }
 
     // Register handlers: pass `this` as cbdata
-    mg_set_request_handler(ctx_, "/api/perf", detail::handlePerf, this);
-    mg_set_request_handler(ctx_, "/api/scene", detail::handleScene, this);
-    mg_set_request_handler(ctx_, "/api/entity/", detail::handleEntity, this);
+    state_->maxParked = 4;
+    detail::setRoutes(ctx_, "", this);
+    detail::startPrecompute(this);
+    state_->gauges.resume();
 
     std::fprintf(stdout, "[reflector] Server running on http://localhost:%d\n", port_);
 }
 
 void Server::stop()
+{
+    state_->gauges.stop();
+    if (host_) {
+        host_->unmount(*this);
+        return;
+    }
+    if (ctx_) {
+        detail::stopPrecompute(*state_);
+        detail::releaseWaiters(*state_);
+        mg_stop(ctx_);
+        mg_exit_library();
+        ctx_ = nullptr;
+        state_->closing = false;
+    }
+}
+
+bool Server::isRunning() const
+{
+    return ctx_ != nullptr || (host_ && host_->isRunning());
+}
+
+void Server::recordFrame(float frameTimeMs)
+{
+    uint64_t frame = state_->main.frames.record(frameTimeMs);
+    state_->main.wake();
+    if (state_->mainThread.pending.load(std::memory_order_acquire))
+        detail::runMainThreadJobs(state_->mainThread);
+#if defined(__linux__)
+    if (state_->exports.pending.load(std::memory_order_relaxed))
+        detail::forkExport(this, state_->exports, frame);
+#endif
+}
+
+void Server::mark(const std::string& name)
+{
+    state_->main.frames.mark(name);
+}
+
+void Server::setTargetFrameRate(float hz)
+{
+    state_->main.frames.setTargetRate(hz);
+}
+
+void Server::setFloatPrecision(int digits)
+{
+    state_->floatPrecision.store(std::clamp(digits, -1, 17), std::memory_order_relaxed);
+}
+
+FrameLoop& Server::addLoop(const std::string& name, float targetHz)
+{
+    std::unique_lock<std::shared_mutex> lock(state_->loopsMutex);
+    for (auto& loop : state_->loops) {
+        if (loop->name() == name)
+            return *loop;
+    }
+    state_->loops.push_back(std::unique_ptr<FrameLoop>(new FrameLoop(name, targetHz)));
+    return *state_->loops.back();
+}
+
+JobGraph& Server::addJobGraph(const std::string& name, int workers)
+{
+    std::unique_lock<std::shared_mutex> lock(state_->jobGraphsMutex);
+    for (auto& graph : state_->jobGraphs) {
+        if (graph->name() == name)
+            return *graph;
+    }
+    state_->jobGraphs.push_back(std::unique_ptr<JobGraph>(new JobGraph(name, workers)));
+    return *state_->jobGraphs.back();
+}
+
+bool Server::addGauge(const std::string& name, std::function<double()> sample, float rateHz)
+{
+    if (name.empty() || name.find('/') != std::string::npos || !sample || !(rateHz > 0.0f && rateHz <= 1000.0f))
+        return false;
+    auto gauge = std::make_shared<detail::GaugeState>();
+    gauge->name = name;
+    gauge->sample = std::move(sample);
+    gauge->rateHz = rateHz;
+    gauge->periodNs = static_cast<int64_t>(1e9 / rateHz);
+    state_->gauges.add(std::move(gauge));
+    return true;
+}
+
+void Server::removeGauge(const std::string& name)
+{
+    state_->gauges.remove(name);
+}
+
+bool Server::route(const std::string& path, RouteHandler handler, RoutePolicy policy)
+{
+    if (!handler)
+        return false;
+    auto route = std::make_shared<detail::CustomRoute>();
+    route->server = this;
+    route->path = path;
+    route->handler = std::move(handler);
+    route->policy = std::move(policy);
+    return addRoute(std::move(route));
+}
+
+bool Server::routeAsync(const std::string& path, AsyncRouteHandler handler, RoutePolicy policy)
+{
+    if (!handler)
+        return false;
+    auto route = std::make_shared<detail::CustomRoute>();
+    route->server = this;
+    route->path = path;
+    route->asyncHandler = std::move(handler);
+    route->policy = std::move(policy);
+    return addRoute(std::move(route));
+}
+
+bool Server::addRoute(std::shared_ptr<detail::CustomRoute> route)
+{
+    const std::string& path = route->path;
+    if (path.size() < 2 || path[0] != '/' || detail::reservedRoute(path))
+        return false;
+
+    std::lock_guard<std::mutex> lock(state_->routesMutex);
+    for (auto& existing : state_->routes) {
+        if (detail::routesOverlap(existing->path, path))
+            return false;
+    }
+    state_->routes.push_back(route);
+    ::mg_context* ctx = host_ ? host_->ctx_ : ctx_;
+    if (ctx)
+        mg_set_request_handler(ctx, (state_->prefix + path).c_str(), detail::handleCustom, route.get());
+    return true;
+}
+
+void Server::runOnMainThread(std::function<void()> job)
+{
+    detail::postMainThreadJob(state_->mainThread, std::move(job));
+}
+
+void Server::runInBackground(std::function<void()> job)
+{
+    detail::postBackgroundJob(state_->background, std::move(job));
+}
+
+void Server::setPrecomputeBudget(float cpuShare)
+{
+    state_->precompute.budget.store(std::clamp(cpuShare, 0.0f, 1.0f));
+    if (isRunning())
+        detail::startPrecompute(this);
+}
+
+bool Server::addWorld(const std::string& name, std::shared_ptr<World> world)
+{
+    if (name.empty() || name.find('/') != std::string::npos || !world)
+        return false;
+    std::unique_lock<std::shared_mutex> lock(state_->worldsMutex);
+    state_->worlds[name] = std::move(world);
+    return true;
+}
+
+void Server::removeWorld(const std::string& name)
+{
+    std::shared_ptr<World> removed;
+    {
+        std::unique_lock<std::shared_mutex> lock(state_->worldsMutex);
+        auto it = state_->worlds.find(name);
+        if (it == state_->worlds.end())
+            return;
+        removed = std::move(it->second);
+        state_->worlds.erase(it);
+    }
+    // Destroyed here, outside the lock, unless a request still holds it
+}
+
+// ---------------------------------------------------------------------------
+// JsonOut / RouteRequest / RouteResponder implementation
+// ---------------------------------------------------------------------------
+
+JsonOut::JsonOut(std::string& out, int precision)
+    : out_(out)
+    , precision_(precision)
+{
+}
+
+// Comma before any element but a level's first, none after a key
+void JsonOut::separate()
+{
+    if (afterKey_) {
+        afterKey_ = false;
+        return;
+    }
+    if (depth_ == 0 || depth_ > kMaxDepth)
+        return;
+    uint64_t bit = 1ull << (depth_ - 1);
+    if (started_ & bit)
+        out_.push_back(',');
+    started_ |= bit;
+}
+
+void JsonOut::open(char bracket)
+{
+    separate();
+    out_.push_back(bracket);
+    if (depth_ < kMaxDepth)
+        started_ &= ~(1ull << depth_);
+    else
+        tooDeep_ = true;
+    ++depth_;
+}
+
+void JsonOut::close(char bracket)
+{
+    out_.push_back(bracket);
+    if (depth_ > 0)
+        --depth_;
+}
+
+JsonOut& JsonOut::beginObject()
+{
+    open('{');
+    return *this;
+}
+
+JsonOut& JsonOut::endObject()
+{
+    close('}');
+    return *this;
+}
+
+JsonOut& JsonOut::beginArray()
+{
+    open('[');
+    return *this;
+}
+
+JsonOut& JsonOut::endArray()
+{
+    close(']');
+    return *this;
+}
+
+JsonOut& JsonOut::key(std::string_view name)
+{
+    separate();
+    detail::JsonWriter(out_).string(name.data(), name.size());
+    out_.push_back(':');
+    afterKey_ = true;
+    return *this;
+}
+
+JsonOut& JsonOut::string(std::string_view v)
+{
+    separate();
+    detail::JsonWriter(out_).string(v.data(), v.size());
+    return *this;
+}
+
+JsonOut& JsonOut::number(double v)
+{
+    separate();
+    detail::JsonWriter(out_, precision_).number(v);
+    return *this;
+}
+
+JsonOut& JsonOut::number(float v)
+{
+    separate();
+    detail::JsonWriter(out_, precision_).number(v);
+    return *this;
+}
+
+JsonOut& JsonOut::integer(int64_t v)
+{
+    separate();
+    detail::JsonWriter(out_).integer(v);
+    return *this;
+}
+
+JsonOut& JsonOut::uint(uint64_t v)
+{
+    separate();
+    detail::JsonWriter(out_).uint(v);
+    return *this;
+}
+
+JsonOut& JsonOut::boolean(bool v)
+{
+    separate();
+    out_.append(v ? "true" : "false");
+    return *this;
+}
+
+JsonOut& JsonOut::null()
+{
+    separate();
+    out_.append("null");
+    return *this;
+}
+
+JsonOut& JsonOut::numbers(const float* v, size_t n)
+{
+    separate();
+    out_.push_back('[');
+    detail::JsonWriter(out_, precision_).numbers(v, n);
+    out_.push_back(']');
+    return *this;
+}
+
+JsonOut& JsonOut::json(const nlohmann::json& v)
+{
+    separate();
+    detail::JsonWriter(out_, precision_).json(v, false);
+    return *this;
+}
+
+JsonOut& JsonOut::raw(std::string_view json)
+{
+    separate();
+    out_.append(json.data(), json.size());
+    return *this;
+}
+
+void RouteResponder::respond(int status, const std::function<void(JsonOut&)>& write) const
+{
+    auto& call = *detail::ServerAccess::token(*this).call;
+    if (done())
+        return;
+    std::string body;
+    JsonOut out = detail::ServerAccess::jsonOut(body, call.precision);
+    write(out);
+    if (detail::ServerAccess::tooDeep(out))
+        detail::completeAsync(call, 500, detail::errorBody("Response nested deeper than 64 levels"));
+    else
+        detail::completeAsync(call, status, std::move(body));
+}
+
+void RouteResponder::fail(int status, const std::string& message) const
+{
+    detail::completeAsync(*detail::ServerAccess::token(*this).call, status, detail::errorBody(message));
+}
+
+bool RouteResponder::done() const
+{
+    auto& call = *detail::ServerAccess::token(*this).call;
+    std::lock_guard<std::mutex> lock(call.mutex);
+    return call.done;
+}
+
+std::optional<std::string> RouteRequest::param(const char* name) const
+{
+    if (query.empty())
+        return std::nullopt;
+    std::string value(query.size() + 1, '\0');
+    int n = mg_get_var(query.data(), query.size(), name, value.data(), value.size());
+    if (n < 0)
+        return std::nullopt;
+    value.resize(static_cast<size_t>(n));
+    return value;
+}
+
+// ---------------------------------------------------------------------------
+// FrameLoop implementation
+// ---------------------------------------------------------------------------
+
+FrameLoop::FrameLoop(std::string name, float targetHz)
+    : name_(std::move(name))
+    , targetHz_(targetHz)
+    , state_(std::make_unique<detail::LoopState>())
+{
+}
+
+FrameLoop::~FrameLoop() = default;
+
+void FrameLoop::begin()
+{
+    state_->openNs = detail::loopClockNs();
+}
+
+void FrameLoop::end()
+{
+    if (state_->openNs < 0)
+        return;
+    state_->publish(state_->openNs, detail::loopClockNs());
+    state_->openNs = -1;
+}
+
+// ---------------------------------------------------------------------------
+// JobGraph implementation
+// ---------------------------------------------------------------------------
+
+JobGraph::JobGraph(std::string name, int workers)
+    : name_(std::move(name))
+    , workers_(std::max(workers, 1))
+    , state_(std::make_unique<detail::JobGraphState>(workers_))
+{
+}
+
+JobGraph::~JobGraph() = default;
+
+void JobGraph::beginFrame()
+{
+    state_->frames.openNs = detail::loopClockNs();
+}
+
+void JobGraph::endFrame()
+{
+    if (state_->frames.openNs < 0)
+        return;
+    state_->frames.publish(state_->frames.openNs, detail::loopClockNs());
+    state_->frames.openNs = -1;
+}
+
+void JobGraph::spawn(int worker, uint64_t job, const char* name)
+{
+    if (worker >= 0 && worker < workers_)
+        state_->rings[worker].publish(detail::JobRing::Spawn, job, reinterpret_cast<uintptr_t>(name));
+}
+
+void JobGraph::depend(int worker, uint64_t job, uint64_t prerequisite)
+{
+    if (worker >= 0 && worker < workers_)
+        state_->rings[worker].publish(detail::JobRing::Depend, job, prerequisite);
+}
+
+void JobGraph::start(int worker, uint64_t job)
+{
+    if (worker >= 0 && worker < workers_)
+        state_->rings[worker].publish(detail::JobRing::Start, job, 0);
+}
+
+void JobGraph::finish(int worker, uint64_t job)
+{
+    if (worker >= 0 && worker < workers_)
+        state_->rings[worker].publish(detail::JobRing::Finish, job, 0);
+}
+
+// ---------------------------------------------------------------------------
+// Host implementation
+// ---------------------------------------------------------------------------
+
+Host::Host(int port, int threads)
+    : port_(port)
+    , threads_(threads)
+    , state_(std::make_unique<detail::HostState>())
+{
+}
+
+Host::~Host()
+{
+    stop();
+    std::lock_guard<std::mutex> lock(state_->mutex);
+    for (auto& [prefix, server] : state_->mounts)
+        server->host_ = nullptr;
+}
+
+void Host::start()
+{
+    if (ctx_)
+        return;
+
+    mg_init_library(0);
+
+    std::string portStr = std::to_string(port_);
+    std::string threadsStr = std::to_string(std::max(1, threads_));
+    const char* options[] = {
+        "listening_ports",
+        portStr.c_str(),
+        "num_threads",
+        threadsStr.c_str(),
+        nullptr,
+    };
+
+    struct mg_callbacks callbacks = {};
+    ctx_ = mg_start(&callbacks, nullptr, options);
+    if (!ctx_) {
+        std::fprintf(stderr, "[reflector] Failed to start host on port %d\n", port_);
+        mg_exit_library();
+        return;
+    }
+
+    mg_set_request_handler(ctx_, "/api/mounts", detail::timed<detail::handleMounts>, state_.get());
+    std::lock_guard<std::mutex> lock(state_->mutex);
+    for (auto& [prefix, server] : state_->mounts) {
+        detail::setRoutes(ctx_, prefix, server);
+        detail::startPrecompute(server);
+    }
+
+    std::fprintf(stdout, "[reflector] Host running on http://localhost:%d\n", port_);
+}
+
+void Host::stop()
 {
     if (ctx_) {
+        // Not under the lock: /api/mounts requests take it and mg_stop()
+        // waits for them
+        std::vector<Server*> servers;
+        {
+            std::lock_guard<std::mutex> lock(state_->mutex);
+            for (auto& [prefix, server] : state_->mounts)
+                servers.push_back(server);
+        }
+        for (auto* server : servers) {
+            detail::stopPrecompute(*server->state_);
+            detail::releaseWaiters(*server->state_);
+        }
         mg_stop(ctx_);
         mg_exit_library();
         ctx_ = nullptr;
+        for (auto* server : servers)
+            server->state_->closing = false;
+    }
+}
+
+bool Host::mount(const std::string& prefix, Server& server)
+{
+    bool validPrefix = prefix.empty() || (prefix[0] == '/' && prefix.back() != '/');
+    if (!validPrefix || server.ctx_ || server.host_)
+        return false;
+
+    std::lock_guard<std::mutex> lock(state_->mutex);
+    if (!state_->mounts.emplace(prefix, &server).second)
+        return false;
+    server.host_ = this;
+    server.state_->prefix = prefix;
+    server.state_->maxParked = std::max(0, threads_ - 2);
+    if (ctx_) {
+        detail::setRoutes(ctx_, prefix, &server);
+        detail::startPrecompute(&server);
     }
+    server.state_->gauges.resume();
+    return true;
+}
+
+void Host::unmount(Server& server)
+{
+    std::lock_guard<std::mutex> lock(state_->mutex);
+    if (server.host_ != this)
+        return;
+    const std::string& prefix = server.state_->prefix;
+    detail::stopPrecompute(*server.state_);
+    detail::releaseWaiters(*server.state_);
+    if (ctx_)
+        detail::setRoutes(ctx_, prefix, &server, false); // waits for in-flight requests
+    state_->mounts.erase(prefix);
+    server.state_->closing = false;
+    server.state_->prefix.clear();
+    server.host_ = nullptr;
 }
 
 } // namespace reflector
@@ -0,0 +1,100 @@
+/*
+ * reflector_test_escape: JsonWriter string escaping against nlohmann
+ *
+ * Escapes random valid UTF-8 strings, biased towards the bytes that need
+ * escaping and with lengths straddling the 16/32-byte SIMD vectors, and
+ * checks that the output matches nlohmann::json::dump() byte for byte.
+ *
+ * Usage:
+ *   reflector_test_escape [--cases 200000] [--seed 7]
+ *
+ * Exit codes: 0 identical, 1 mismatch, 2 usage error.
+ */
+
+#define REFLECTOR_IMPLEMENTATION
+#include "reflector.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+
+namespace {
+
+using reflector::detail::JsonWriter;
+
+struct Options {
+    size_t cases = 200000;
+    unsigned seed = 7;
+};
+
+// Random valid UTF-8 (nlohmann rejects anything else) biased towards the
+// bytes that need escaping, with lengths straddling the 16/32-byte vectors
+std::string randomString(std::mt19937& rng)
+{
+    static const char special[] = { '"', '\\', '\b', '\f', '\n', '\r', '\t', '\0', 0x01, 0x1f, 0x7f, '/' };
+    std::uniform_int_distribution<int> length(0, 80);
+    std::uniform_int_distribution<int> kind(0, 99);
+    std::uniform_int_distribution<int> ascii(0x20, 0x7e);
+    std::uniform_int_distribution<int> cont(0x80, 0xbf);
+
+    std::string s;
+    int n = length(rng);
+    int escapeOdds = kind(rng) % 4 == 0 ? 0 : kind(rng) % 20; // a quarter are escape-free
+    while (static_cast<int>(s.size()) < n) {
+        int k = kind(rng);
+        if (k < escapeOdds) {
+            s.push_back(special[static_cast<size_t>(k) % sizeof(special)]);
+        } else if (k < 92) {
+            s.push_back(static_cast<char>(ascii(rng)));
+        } else if (k < 96) {
+            s.push_back(static_cast<char>(0xc2 + k % 30)); // 2-byte sequence
+            s.push_back(static_cast<char>(cont(rng)));
+        } else {
+            s.push_back(static_cast<char>(0xe1 + k % 12)); // 3-byte sequence
+            s.push_back(static_cast<char>(cont(rng)));
+            s.push_back(static_cast<char>(cont(rng)));
+        }
+    }
+    return s;
+}
+
+int usage()
+{
+    std::fprintf(stderr, "usage: reflector_test_escape [--cases N] [--seed N]\n");
+    return 2;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    Options opt;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--cases" && hasValue)
+            opt.cases = std::strtoull(argv[++i], nullptr, 10);
+        else if (arg == "--seed" && hasValue)
+            opt.seed = static_cast<unsigned>(std::strtoul(argv[++i], nullptr, 10));
+        else
+            return usage();
+    }
+
+    std::mt19937 rng(opt.seed);
+    std::string out;
+    for (size_t i = 0; i < opt.cases; ++i) {
+        std::string s = randomString(rng);
+        std::string expected = nlohmann::json(s).dump();
+        out.clear();
+        JsonWriter w(out);
+        w.string(s);
+        if (out != expected) {
+            std::fprintf(stderr, "escape: mismatch on case %zu:\n  nlohmann: %s\n  writer:   %s\n",
+                i, expected.c_str(), out.c_str());
+            return 1;
+        }
+    }
+    std::printf("escape: ok after %zu cases\n", opt.cases);
+    return 0;
+}
@@ -0,0 +1,174 @@
+/*
+ * reflector_test_rings: stress test for the lock-free sample rings
+ *
+ * One writer publishes records whose fields are all derived from their
+ * sequence number, as fast as it can, so the rings wrap thousands of times;
+ * readers copy concurrently and check every record they get back against
+ * the number it was returned under. A torn or overwritten slot shows up as
+ * a mismatch.
+ *
+ * Usage:
+ *   reflector_test_rings [--seconds 2] [--readers 3]
+ *
+ * Exit codes: 0 consistent, 1 mismatch, 2 usage error.
+ */
+
+#define REFLECTOR_IMPLEMENTATION
+#include "reflector.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using reflector::detail::GaugeState;
+using reflector::detail::JobRing;
+using reflector::detail::LoopState;
+
+struct Options {
+    double seconds = 2.0;
+    int readers = 3;
+};
+
+// Runs `write(n)` for n = 1, 2, ... on one thread and `read()` on the
+// others until the time is up or a reader fails. Returns the reads done.
+template <typename Write, typename Read>
+uint64_t race(const Options& opt, const char* name, Write&& write, Read&& read)
+{
+    std::atomic<bool> stop { false };
+    std::atomic<bool> failed { false };
+    std::atomic<uint64_t> reads { 0 };
+
+    std::thread writer([&] {
+        for (uint64_t n = 1; !stop.load(std::memory_order_relaxed); ++n)
+            write(n);
+    });
+    std::vector<std::thread> readers;
+    for (int i = 0; i < opt.readers; ++i) {
+        readers.emplace_back([&] {
+            while (!stop.load(std::memory_order_relaxed)) {
+                if (!read()) {
+                    failed = true;
+                    stop = true;
+                }
+                reads.fetch_add(1, std::memory_order_relaxed);
+            }
+        });
+    }
+
+    std::this_thread::sleep_for(std::chrono::duration<double>(opt.seconds));
+    stop = true;
+    writer.join();
+    for (auto& t : readers)
+        t.join();
+
+    std::printf("%s: %s after %llu reads\n", name, failed ? "FAILED" : "ok", static_cast<unsigned long long>(reads.load()));
+    return failed ? 0 : reads.load();
+}
+
+bool testLoopState(const Options& opt)
+{
+    LoopState ring;
+    return race(
+               opt, "LoopState",
+               [&](uint64_t n) { ring.publish(static_cast<int64_t>(n), -static_cast<int64_t>(n) * 3); },
+               [&] {
+                   std::vector<LoopState::Span> spans;
+                   uint64_t latest = 0;
+                   uint64_t first = ring.copySince(0, spans, latest);
+                   for (size_t i = 0; i < spans.size(); ++i) {
+                       int64_t n = static_cast<int64_t>(first + i);
+                       if (spans[i].beginNs != n || spans[i].endNs != -n * 3) {
+                           std::fprintf(stderr, "LoopState: span %lld came back as [%lld, %lld)\n", static_cast<long long>(n),
+                               static_cast<long long>(spans[i].beginNs), static_cast<long long>(spans[i].endNs));
+                           return false;
+                       }
+                   }
+                   return true;
+               })
+        > 0;
+}
+
+bool testGaugeState(const Options& opt)
+{
+    GaugeState ring;
+    return race(
+               opt, "GaugeState",
+               [&](uint64_t n) { ring.publish(static_cast<int64_t>(n), static_cast<double>(n) * 0.5); },
+               [&] {
+                   std::vector<GaugeState::Sample> samples;
+                   uint64_t latest = 0;
+                   uint64_t first = ring.copySince(0, samples, latest);
+                   for (size_t i = 0; i < samples.size(); ++i) {
+                       uint64_t n = first + i;
+                       if (samples[i].timeNs != static_cast<int64_t>(n) || samples[i].value != static_cast<double>(n) * 0.5) {
+                           std::fprintf(stderr, "GaugeState: sample %llu came back as (%lld, %g)\n", static_cast<unsigned long long>(n),
+                               static_cast<long long>(samples[i].timeNs), samples[i].value);
+                           return false;
+                       }
+                   }
+                   return true;
+               })
+        > 0;
+}
+
+// Job events carry a clock timestamp, so they are checked against each
+// other: consecutive jobs, fields that agree, time never going backwards
+bool testJobRing(const Options& opt)
+{
+    JobRing ring;
+    auto kindOf = [](uint64_t job) { return static_cast<JobRing::Kind>(job % 4 + 1); };
+    return race(
+               opt, "JobRing",
+               [&](uint64_t n) { ring.publish(kindOf(n), n, n * 7); },
+               [&] {
+                   std::vector<JobRing::Event> events;
+                   ring.copy(events);
+                   for (size_t i = 0; i < events.size(); ++i) {
+                       const auto& e = events[i];
+                       bool ok = e.kind == kindOf(e.job) && e.arg == e.job * 7;
+                       if (i > 0)
+                           ok = ok && e.job == events[i - 1].job + 1 && e.timeNs >= events[i - 1].timeNs;
+                       if (!ok) {
+                           std::fprintf(stderr, "JobRing: event %zu came back as job %llu, kind %d, arg %llu\n", i,
+                               static_cast<unsigned long long>(e.job), static_cast<int>(e.kind), static_cast<unsigned long long>(e.arg));
+                           return false;
+                       }
+                   }
+                   return true;
+               })
+        > 0;
+}
+
+int usage()
+{
+    std::fprintf(stderr, "usage: reflector_test_rings [--seconds S] [--readers N]\n");
+    return 2;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    Options opt;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--seconds" && hasValue)
+            opt.seconds = std::atof(argv[++i]);
+        else if (arg == "--readers" && hasValue)
+            opt.readers = std::max(1, std::atoi(argv[++i]));
+        else
+            return usage();
+    }
+
+    bool ok = testLoopState(opt);
+    ok = testGaugeState(opt) && ok;
+    ok = testJobRing(opt) && ok;
+    return ok ? 0 : 1;
+}
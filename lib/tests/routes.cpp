@@ -0,0 +1,84 @@
+/*
+ * reflector_test_routes: custom route registration against the built-ins
+ *
+ * CivetWeb hands a handler every request below its path, so a custom route
+ * that equals, contains or extends a built-in (or another custom route)
+ * would take over some of its requests. Registers a table of paths on a
+ * server that is never started and checks which ones are refused.
+ *
+ * Usage:
+ *   reflector_test_routes
+ *
+ * Exit codes: 0 as expected, 1 mismatch, 2 usage error.
+ */
+
+#define REFLECTOR_IMPLEMENTATION
+#include "reflector.h"
+
+#include <cstdio>
+
+namespace {
+
+struct TestServer : reflector::Server {
+    reflector::PerfMetrics onGetPerf() override { return {}; }
+    std::vector<reflector::SceneNode> onGetScene() override { return {}; }
+    std::optional<reflector::EntityInfo> onGetEntity(uintptr_t) override { return std::nullopt; }
+};
+
+struct Case {
+    const char* path;
+    bool accepted;
+};
+
+// In order: each row sees the routes accepted above it
+const Case kCases[] = {
+    { "", false },
+    { "/", false },
+    { "api/navmesh", false },
+    { "/api", false }, // contains every built-in
+    { "/api/", false },
+    { "/api/scene", false },
+    { "/api/scene/", false },
+    { "/api/scene/x", false }, // under a built-in
+    { "/api/entity", false }, // "/api/entity/" without the '/'
+    { "/api/entity/5", false },
+    { "/api/w", false },
+    { "/api/w/main/custom", false },
+    { "/api/perf/frames/x", false },
+    { "/api/mounts", false }, // a Host's
+    { "/api/scenes", true }, // shares characters, not a segment
+    { "/api/entityx", true },
+    { "/api/navmesh", true },
+    { "/api/navmesh", false },
+    { "/api/navmesh/", false },
+    { "/api/navmesh/tiles", false },
+    { "/api/nav", true },
+    { "/tools/a/b", true },
+    { "/tools", false },
+    { "/tools/a", false },
+    { "/tools/b", true },
+};
+
+} // namespace
+
+int main(int argc, char**)
+{
+    if (argc > 1) {
+        std::fprintf(stderr, "usage: reflector_test_routes\n");
+        return 2;
+    }
+
+    TestServer server;
+    int failures = 0;
+    for (auto& c : kCases) {
+        bool accepted = server.route(c.path, [](const reflector::RouteRequest&, reflector::JsonOut&) { return 200; });
+        if (accepted != c.accepted) {
+            std::fprintf(stderr, "routes: \"%s\" was %s\n", c.path, accepted ? "accepted" : "refused");
+            ++failures;
+        }
+    }
+    if (failures)
+        return 1;
+    std::printf("routes: ok after %zu paths\n", sizeof(kCases) / sizeof(kCases[0]));
+    return 0;
+}
@@ -0,0 +1,175 @@
+/*
+ * reflector_bench: serializer micro-benchmarks
+ *
+ * Times reflector's JsonWriter against nlohmann::json::dump() on the payloads
+ * the server produces most: float-heavy entity properties (Points2D), the
+ * frame-time arrays of /api/perf/frames and entity names. Prints a JSON report.
+ * (String escaping parity with nlohmann is checked by tests/escape.cpp.)
+ *
+ * Usage:
+ *   reflector_bench [--iterations 20] [--points 100000] [--frames 8192]
+ *                   [--names 100000]
+ */
+
+#define REFLECTOR_IMPLEMENTATION
+#include "reflector.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+using reflector::detail::JsonWriter;
+
+struct Options {
+    int iterations = 20;
+    size_t points = 100000;
+    size_t frames = 8192;
+    size_t names = 100000;
+};
+
+// Best-of-N wall time in milliseconds; `bytes` receives the output size
+template <typename Fn>
+double bestOf(int iterations, size_t& bytes, Fn&& fn)
+{
+    double best = 1e300;
+    for (int i = 0; i < iterations; ++i) {
+        auto t0 = std::chrono::steady_clock::now();
+        std::string out = fn();
+        std::chrono::duration<double, std::milli> dt = std::chrono::steady_clock::now() - t0;
+        best = std::min(best, dt.count());
+        bytes = out.size();
+    }
+    return best;
+}
+
+nlohmann::json entityToJson(const reflector::EntityInfo& e)
+{
+    nlohmann::json props = nlohmann::json::array();
+    for (auto& p : e) {
+        props.push_back({
+            { "name", p.name },
+            { "type", reflector::detail::propertyTypeName(p.type) },
+            { "value", p.value },
+        });
+    }
+    return { { "properties", props } };
+}
+
+nlohmann::json result(const char* name, double ms, size_t bytes, size_t values, double baselineMs)
+{
+    return {
+        { "name", name },
+        { "ms", ms },
+        { "bytes", bytes },
+        { "nsPerValue", ms * 1e6 / static_cast<double>(values) },
+        { "speedup", baselineMs / ms },
+    };
+}
+
+int usage()
+{
+    std::fprintf(stderr,
+        "usage: reflector_bench [--iterations N] [--points N] [--frames N]\n"
+        "                       [--names N]\n");
+    return 2;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    Options opt;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--iterations" && hasValue)
+            opt.iterations = std::max(1, std::atoi(argv[++i]));
+        else if (arg == "--points" && hasValue)
+            opt.points = std::strtoull(argv[++i], nullptr, 10);
+        else if (arg == "--frames" && hasValue)
+            opt.frames = std::strtoull(argv[++i], nullptr, 10);
+        else if (arg == "--names" && hasValue)
+            opt.names = std::strtoull(argv[++i], nullptr, 10);
+        else
+            return usage();
+    }
+
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<float> coord(-1000.0f, 1000.0f);
+    std::normal_distribution<float> frameTime(16.6f, 1.5f);
+
+    std::vector<std::pair<float, float>> pts(opt.points);
+    for (auto& p : pts)
+        p = { coord(rng), coord(rng) };
+    reflector::EntityInfo entity = {
+        reflector::Property::Float("speed", 3.14159f),
+        reflector::Property::Points2D("path", pts),
+    };
+
+    std::vector<float> frames(opt.frames);
+    for (auto& f : frames)
+        f = frameTime(rng);
+
+    nlohmann::json report = nlohmann::json::array();
+    size_t bytes = 0;
+
+    // Entity with a large Points2D property
+    size_t entityValues = opt.points * 2 + 1;
+    double base = bestOf(opt.iterations, bytes, [&] { return entityToJson(entity).dump(); });
+    report.push_back(result("entity/nlohmann", base, bytes, entityValues, base));
+    for (int precision : { -1, 3 }) {
+        double ms = bestOf(opt.iterations, bytes, [&] {
+            std::string out;
+            JsonWriter w(out, precision);
+            reflector::detail::writeEntity(w, entity);
+            return out;
+        });
+        report.push_back(result(precision < 0 ? "entity/writer" : "entity/writer-p3", ms, bytes, entityValues, base));
+    }
+
+    // Frame-time array
+    base = bestOf(opt.iterations, bytes, [&] { return nlohmann::json(frames).dump(); });
+    report.push_back(result("frames/nlohmann", base, bytes, opt.frames, base));
+    for (int precision : { -1, 3 }) {
+        double ms = bestOf(opt.iterations, bytes, [&] {
+            std::string out;
+            JsonWriter w(out, precision);
+            w.raw("[", 1);
+            w.numbers(frames.data(), frames.size());
+            w.raw("]", 1);
+            return out;
+        });
+        report.push_back(result(precision < 0 ? "frames/writer" : "frames/writer-p3", ms, bytes, opt.frames, base));
+    }
+
+    // Entity names: mostly plain identifiers, a few needing escapes
+    std::vector<std::string> names(opt.names);
+    for (size_t i = 0; i < names.size(); ++i) {
+        names[i] = i % 100 == 0 ? "Path \"" + std::to_string(i) + "\"\tC:\\assets"
+                                : "Enemy_Spawner_" + std::to_string(i) + "_RootTransform";
+    }
+    nlohmann::json namesJson = names;
+    base = bestOf(opt.iterations, bytes, [&] { return namesJson.dump(); });
+    report.push_back(result("names/nlohmann", base, bytes, opt.names, base));
+    double ms = bestOf(opt.iterations, bytes, [&] {
+        std::string out;
+        JsonWriter w(out);
+        w.raw("[", 1);
+        for (size_t i = 0; i < names.size(); ++i) {
+            if (i > 0)
+                w.raw(",", 1);
+            w.string(names[i]);
+        }
+        w.raw("]", 1);
+        return out;
+    });
+    report.push_back(result("names/writer", ms, bytes, opt.names, base));
+
+    std::printf("%s\n", report.dump(2).c_str());
+    return 0;
+}
@@ -0,0 +1,278 @@
+/*
+ * reflector_merklediff: find where two running instances' scenes diverge
+ *
+ * Walks /api/merkle on both instances from the scene root down, descending
+ * only into subtrees whose hashes differ, so a single divergent entity is
+ * found in one round trip per tree level instead of dumping both worlds.
+ * Nodes are matched by position (child index), not id, since ids are often
+ * pointers that differ between processes. For entities whose property
+ * hashes differ, both /api/entity responses are fetched and the differing
+ * properties listed. Prints a JSON report.
+ *
+ * Compare instances at the same simulation frame (paused, or in lockstep):
+ * each /api/merkle response is taken at whatever frame its instance is at.
+ *
+ * Usage:
+ *   reflector_merklediff --a localhost:7700 --b localhost:7701
+ *                        [--prefix /mount] [--world NAME] [--max 16]
+ *
+ * Exit codes: 0 identical, 1 divergent, 2 usage/connection error.
+ */
+
+#include <civetweb.h>
+#include <nlohmann/json.hpp>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <optional>
+#include <string>
+
+namespace {
+
+struct Instance {
+    std::string host = "localhost";
+    int port = 0;
+};
+
+struct Options {
+    Instance a;
+    Instance b;
+    std::string prefix; // Host mount prefix, "" when standalone
+    std::string world; // compare this world instead of the server's scene
+    size_t max = 16; // stop after this many divergences
+};
+
+// ---------------------------------------------------------------------------
+// HTTP
+// ---------------------------------------------------------------------------
+
+std::optional<nlohmann::json> httpGetJson(const Instance& inst, const std::string& path)
+{
+    char err[256] = {};
+    mg_connection* conn = mg_connect_client(inst.host.c_str(), inst.port, 0, err, sizeof(err));
+    if (!conn)
+        return std::nullopt;
+
+    mg_printf(conn,
+        "GET %s HTTP/1.1\r\n"
+        "Host: %s\r\n"
+        "Connection: close\r\n"
+        "\r\n",
+        path.c_str(), inst.host.c_str());
+
+    std::optional<nlohmann::json> result;
+    if (mg_get_response(conn, err, sizeof(err), 5000) >= 0) {
+        const mg_response_info* info = mg_get_response_info(conn);
+        std::string body;
+        char buf[16384];
+        int n;
+        while ((n = mg_read(conn, buf, sizeof(buf))) > 0)
+            body.append(buf, static_cast<size_t>(n));
+        if (info && info->status_code == 200)
+            result = nlohmann::json::parse(body, nullptr, false);
+        if (result && result->is_discarded())
+            result.reset();
+    }
+    mg_close_connection(conn);
+    return result;
+}
+
+std::optional<Instance> parseInstance(const std::string& s)
+{
+    size_t colon = s.rfind(':');
+    if (colon == std::string::npos || colon == 0)
+        return std::nullopt;
+    Instance inst { s.substr(0, colon), std::atoi(s.c_str() + colon + 1) };
+    if (inst.port <= 0)
+        return std::nullopt;
+    return inst;
+}
+
+// ---------------------------------------------------------------------------
+// Diff
+// ---------------------------------------------------------------------------
+
+class Differ {
+public:
+    explicit Differ(const Options& opt)
+        : opt_(opt)
+        , base_(opt.prefix + (opt.world.empty() ? "/api/" : "/api/w/" + opt.world + "/"))
+    {
+    }
+
+    // False if either instance stopped answering
+    bool run()
+    {
+        ++roundTrips_;
+        auto a = merkle(opt_.a, "");
+        auto b = merkle(opt_.b, "");
+        if (!a || !b)
+            return false;
+        report_["frames"] = { { "a", (*a)["frame"] }, { "b", (*b)["frame"] } };
+        return (*a)["hash"] == (*b)["hash"] || compareChildren("", *a, *b);
+    }
+
+    nlohmann::json report()
+    {
+        report_["identical"] = divergences_.empty();
+        report_["truncated"] = divergences_.size() >= opt_.max;
+        report_["roundTrips"] = roundTrips_;
+        report_["divergences"] = divergences_;
+        return report_;
+    }
+
+    bool identical() const { return divergences_.empty(); }
+
+private:
+    std::optional<nlohmann::json> merkle(const Instance& inst, const std::string& path)
+    {
+        return httpGetJson(inst, base_ + "merkle?path=" + path);
+    }
+
+    static nlohmann::json describe(const nlohmann::json& node)
+    {
+        return { { "id", node["id"] }, { "type", node["type"] }, { "name", node["name"] } };
+    }
+
+    static std::string childPath(const std::string& parent, size_t index)
+    {
+        return parent.empty() ? std::to_string(index) : parent + "/" + std::to_string(index);
+    }
+
+    bool full() const { return divergences_.size() >= opt_.max; }
+
+    // Pairs up the children of two nodes whose subtree hashes differ. Each
+    // child summary already carries its own type, name and entity hash, so
+    // only children with differing descendants cost another round trip.
+    bool compareChildren(const std::string& path, const nlohmann::json& a, const nlohmann::json& b)
+    {
+        const auto& ca = a["children"];
+        const auto& cb = b["children"];
+        size_t common = std::min(ca.size(), cb.size());
+        for (size_t i = 0; i < common && !full(); ++i) {
+            if (ca[i]["hash"] == cb[i]["hash"])
+                continue;
+            std::string p = childPath(path, i);
+            if (!compareNode(p, ca[i], cb[i]))
+                return false;
+            if (ca[i]["size"].get<uint64_t>() > 1 || cb[i]["size"].get<uint64_t>() > 1) {
+                ++roundTrips_;
+                auto na = merkle(opt_.a, p);
+                auto nb = merkle(opt_.b, p);
+                if (!na || !nb)
+                    return false;
+                if ((*na)["hash"] != (*nb)["hash"] && !compareChildren(p, *na, *nb))
+                    return false;
+            }
+        }
+        if (ca.size() != cb.size() && !full()) {
+            nlohmann::json extra = nlohmann::json::array();
+            const auto& longer = ca.size() > cb.size() ? ca : cb;
+            for (size_t i = common; i < longer.size(); ++i)
+                extra.push_back(describe(longer[i]));
+            divergences_.push_back({
+                { "path", path },
+                { "kind", "children" },
+                { "count", { { "a", ca.size() }, { "b", cb.size() } } },
+                { ca.size() > cb.size() ? "onlyA" : "onlyB", extra },
+            });
+        }
+        return true;
+    }
+
+    // Reports a node whose own type, name or properties differ
+    bool compareNode(const std::string& path, const nlohmann::json& a, const nlohmann::json& b)
+    {
+        if (a["type"] != b["type"] || a["name"] != b["name"]) {
+            divergences_.push_back({ { "path", path }, { "kind", "node" }, { "a", describe(a) }, { "b", describe(b) } });
+            return true;
+        }
+        if (a["entity"] == b["entity"])
+            return true;
+
+        ++roundTrips_;
+        auto ea = httpGetJson(opt_.a, base_ + "entity/" + a["id"].get<std::string>());
+        auto eb = httpGetJson(opt_.b, base_ + "entity/" + b["id"].get<std::string>());
+        if (!ea || !eb)
+            return false;
+
+        // Properties by name, in A's order, then any only B has
+        nlohmann::json props = nlohmann::json::array();
+        const auto& pa = (*ea)["properties"];
+        const auto& pb = (*eb)["properties"];
+        auto findIn = [](const nlohmann::json& list, const nlohmann::json& name) -> const nlohmann::json* {
+            for (auto& p : list) {
+                if (p["name"] == name)
+                    return &p;
+            }
+            return nullptr;
+        };
+        for (auto& p : pa) {
+            const nlohmann::json* q = findIn(pb, p["name"]);
+            if (!q || (*q)["value"] != p["value"] || (*q)["type"] != p["type"])
+                props.push_back({ { "name", p["name"] }, { "a", p["value"] }, { "b", q ? (*q)["value"] : nlohmann::json() } });
+        }
+        for (auto& q : pb) {
+            if (!findIn(pa, q["name"]))
+                props.push_back({ { "name", q["name"] }, { "a", nullptr }, { "b", q["value"] } });
+        }
+        divergences_.push_back({ { "path", path }, { "kind", "entity" }, { "a", describe(a) }, { "b", describe(b) }, { "properties", props } });
+        return true;
+    }
+
+    const Options& opt_;
+    std::string base_;
+    nlohmann::json report_ = nlohmann::json::object();
+    nlohmann::json divergences_ = nlohmann::json::array();
+    uint64_t roundTrips_ = 0; // requests to each instance
+};
+
+int usage()
+{
+    std::fprintf(stderr,
+        "usage: reflector_merklediff --a HOST:PORT --b HOST:PORT\n"
+        "                            [--prefix /mount] [--world NAME] [--max N]\n");
+    return 2;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    Options opt;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if ((arg == "--a" || arg == "--b") && hasValue) {
+            auto inst = parseInstance(argv[++i]);
+            if (!inst) {
+                std::fprintf(stderr, "invalid instance: %s\n", argv[i]);
+                return usage();
+            }
+            (arg == "--a" ? opt.a : opt.b) = *inst;
+        } else if (arg == "--prefix" && hasValue)
+            opt.prefix = argv[++i];
+        else if (arg == "--world" && hasValue)
+            opt.world = argv[++i];
+        else if (arg == "--max" && hasValue)
+            opt.max = static_cast<size_t>(std::max(1, std::atoi(argv[++i])));
+        else
+            return usage();
+    }
+    if (opt.a.port == 0 || opt.b.port == 0)
+        return usage();
+
+    mg_init_library(0);
+    Differ differ(opt);
+    bool ok = differ.run();
+    mg_exit_library();
+    if (!ok) {
+        std::fprintf(stderr, "[merklediff] cannot reach both instances' %s/api/%smerkle\n",
+            opt.prefix.c_str(), opt.world.empty() ? "" : ("w/" + opt.world + "/").c_str());
+        return 2;
+    }
+
+    std::printf("%s\n", differ.report().dump(2).c_str());
+    return differ.identical() ? 0 : 1;
+}
@@ -0,0 +1,303 @@
+/*
+ * reflector_perfgate: frame-time budget gate for a running reflector::Server
+ *
+ * Attaches to /api/perf/frames, collects every recorded frame for a time
+ * window (or between markers), evaluates declarative budgets and prints a
+ * JSON report. Intended for nightly soak tests that gate on in-game perf.
+ *
+ * Usage:
+ *   reflector_perfgate [--host localhost] [--port 7700] [--duration 30]
+ *                      [--after MARKER] [--until MARKER] [--timeout 3600]
+ *                      [--poll-ms 250]
+ *                      --budget "p99<20" --budget "max<50" --budget "rss_growth_mb<64"
+ *
+ * Metrics: avg, p50, p90, p95, p99, max (ms), frames, rss_growth_mb.
+ * Operators: <, <=, >, >=.
+ *
+ * --timeout bounds the wait for markers: if --after or --until has not
+ * arrived that many seconds after attaching, the gate fails.
+ *
+ * Exit codes: 0 all budgets met, 1 a budget failed or a marker never came,
+ * 2 usage/connection error.
+ */
+
+#include <civetweb.h>
+#include <nlohmann/json.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+struct Budget {
+    std::string expr;
+    std::string metric;
+    std::string op;
+    double limit;
+};
+
+struct Options {
+    std::string host = "localhost";
+    int port = 7700;
+    double durationS = 30.0;
+    double timeoutS = 3600.0; // for markers to arrive
+    int pollMs = 250;
+    std::string after;
+    std::string until;
+    std::vector<Budget> budgets;
+};
+
+// ---------------------------------------------------------------------------
+// HTTP
+// ---------------------------------------------------------------------------
+
+std::optional<nlohmann::json> httpGetJson(const Options& opt, const std::string& path)
+{
+    char err[256] = {};
+    mg_connection* conn = mg_connect_client(opt.host.c_str(), opt.port, 0, err, sizeof(err));
+    if (!conn)
+        return std::nullopt;
+
+    mg_printf(conn,
+        "GET %s HTTP/1.1\r\n"
+        "Host: %s\r\n"
+        "Connection: close\r\n"
+        "\r\n",
+        path.c_str(), opt.host.c_str());
+
+    std::optional<nlohmann::json> result;
+    if (mg_get_response(conn, err, sizeof(err), 5000) >= 0) {
+        const mg_response_info* info = mg_get_response_info(conn);
+        std::string body;
+        char buf[16384];
+        int n;
+        while ((n = mg_read(conn, buf, sizeof(buf))) > 0)
+            body.append(buf, static_cast<size_t>(n));
+        if (info && info->status_code == 200)
+            result = nlohmann::json::parse(body, nullptr, false);
+        if (result && result->is_discarded())
+            result.reset();
+    }
+    mg_close_connection(conn);
+    return result;
+}
+
+// ---------------------------------------------------------------------------
+// Budgets
+// ---------------------------------------------------------------------------
+
+std::optional<Budget> parseBudget(const std::string& expr)
+{
+    static const char* ops[] = { "<=", ">=", "<", ">" };
+    for (const char* op : ops) {
+        size_t pos = expr.find(op);
+        if (pos == std::string::npos || pos == 0)
+            continue;
+        char* end = nullptr;
+        std::string rhs = expr.substr(pos + std::strlen(op));
+        double limit = std::strtod(rhs.c_str(), &end);
+        if (end == rhs.c_str())
+            return std::nullopt;
+        return Budget { expr, expr.substr(0, pos), op, limit };
+    }
+    return std::nullopt;
+}
+
+bool compare(double value, const std::string& op, double limit)
+{
+    if (op == "<")
+        return value < limit;
+    if (op == "<=")
+        return value <= limit;
+    if (op == ">")
+        return value > limit;
+    return value >= limit;
+}
+
+double percentile(const std::vector<float>& sorted, double p)
+{
+    if (sorted.empty())
+        return 0.0;
+    size_t rank = static_cast<size_t>(std::ceil(p / 100.0 * sorted.size()));
+    return sorted[std::clamp<size_t>(rank, 1, sorted.size()) - 1];
+}
+
+int usage()
+{
+    std::fprintf(stderr,
+        "usage: reflector_perfgate [--host H] [--port P] [--duration S] [--poll-ms MS]\n"
+        "                          [--after MARKER] [--until MARKER] [--timeout S]\n"
+        "                          --budget EXPR...\n"
+        "  EXPR: <metric><op><limit>, e.g. p99<20, max<50, rss_growth_mb<64\n"
+        "  metrics: avg p50 p90 p95 p99 max frames rss_growth_mb\n");
+    return 2;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    Options opt;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--host" && hasValue)
+            opt.host = argv[++i];
+        else if (arg == "--port" && hasValue)
+            opt.port = std::atoi(argv[++i]);
+        else if (arg == "--duration" && hasValue)
+            opt.durationS = std::atof(argv[++i]);
+        else if (arg == "--poll-ms" && hasValue)
+            opt.pollMs = std::max(10, std::atoi(argv[++i]));
+        else if (arg == "--after" && hasValue)
+            opt.after = argv[++i];
+        else if (arg == "--until" && hasValue)
+            opt.until = argv[++i];
+        else if (arg == "--timeout" && hasValue)
+            opt.timeoutS = std::atof(argv[++i]);
+        else if (arg == "--budget" && hasValue) {
+            auto b = parseBudget(argv[++i]);
+            if (!b) {
+                std::fprintf(stderr, "invalid budget: %s\n", argv[i]);
+                return usage();
+            }
+            opt.budgets.push_back(*b);
+        } else
+            return usage();
+    }
+
+    mg_init_library(0);
+
+    // Attach: everything recorded before now is ignored
+    auto attach = httpGetJson(opt, "/api/perf/frames?since=" + std::to_string(~0ull >> 1));
+    if (!attach) {
+        std::fprintf(stderr, "[perfgate] cannot reach http://%s:%d/api/perf/frames\n", opt.host.c_str(), opt.port);
+        mg_exit_library();
+        return 2;
+    }
+
+    uint64_t since = (*attach)["latest"].get<uint64_t>();
+    uint64_t rssStart = (*attach)["rssBytes"].get<uint64_t>();
+    uint64_t rssEnd = rssStart;
+    uint64_t dropped = 0;
+    bool collecting = opt.after.empty();
+    bool stoppedByMarker = false;
+    std::string missingMarker; // set if the timeout passed while waiting for it
+    std::vector<float> frames;
+    nlohmann::json markers = nlohmann::json::array();
+
+    auto attached = std::chrono::steady_clock::now();
+    auto windowStart = attached;
+    while (true) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(opt.pollMs));
+
+        auto batch = httpGetJson(opt, "/api/perf/frames?since=" + std::to_string(since));
+        if (!batch) {
+            std::fprintf(stderr, "[perfgate] lost connection\n");
+            mg_exit_library();
+            return 2;
+        }
+
+        uint64_t first = (*batch)["first"].get<uint64_t>();
+        auto& times = (*batch)["frameTimeMs"];
+        auto& batchMarkers = (*batch)["markers"];
+        size_t marker = 0;
+        if (collecting)
+            dropped += (*batch)["dropped"].get<uint64_t>();
+
+        for (size_t i = 0; i < times.size() && !stoppedByMarker; ++i) {
+            uint64_t frame = first + i;
+            // Markers apply before the frame they are stamped with
+            for (; marker < batchMarkers.size() && batchMarkers[marker]["frame"].get<uint64_t>() <= frame; ++marker) {
+                std::string name = batchMarkers[marker]["name"];
+                markers.push_back(batchMarkers[marker]);
+                if (!collecting && name == opt.after) {
+                    collecting = true;
+                    windowStart = std::chrono::steady_clock::now();
+                    rssStart = (*batch)["rssBytes"].get<uint64_t>();
+                } else if (collecting && name == opt.until) {
+                    stoppedByMarker = true;
+                }
+            }
+            if (collecting && !stoppedByMarker)
+                frames.push_back(times[i].get<float>());
+        }
+
+        since = (*batch)["latest"].get<uint64_t>();
+        if (collecting)
+            rssEnd = (*batch)["rssBytes"].get<uint64_t>();
+
+        if (stoppedByMarker)
+            break;
+        if (collecting && opt.until.empty()) {
+            std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - windowStart;
+            if (elapsed.count() >= opt.durationS)
+                break;
+        }
+
+        std::string awaited = !collecting ? opt.after : opt.until;
+        std::chrono::duration<double> waited = std::chrono::steady_clock::now() - attached;
+        if (!awaited.empty() && waited.count() >= opt.timeoutS) {
+            std::fprintf(stderr, "[perfgate] marker \"%s\" not seen within %gs\n", awaited.c_str(), opt.timeoutS);
+            missingMarker = awaited;
+            break;
+        }
+    }
+    mg_exit_library();
+
+    // Statistics
+    std::vector<float> sorted = frames;
+    std::sort(sorted.begin(), sorted.end());
+    double sum = 0.0;
+    for (float f : frames)
+        sum += f;
+
+    nlohmann::json stats = {
+        { "frames", frames.size() },
+        { "avg", frames.empty() ? 0.0 : sum / frames.size() },
+        { "p50", percentile(sorted, 50) },
+        { "p90", percentile(sorted, 90) },
+        { "p95", percentile(sorted, 95) },
+        { "p99", percentile(sorted, 99) },
+        { "max", sorted.empty() ? 0.0 : sorted.back() },
+        { "rss_growth_mb", (static_cast<double>(rssEnd) - static_cast<double>(rssStart)) / (1024.0 * 1024.0) },
+    };
+
+    bool pass = missingMarker.empty();
+    nlohmann::json results = nlohmann::json::array();
+    for (auto& b : opt.budgets) {
+        nlohmann::json result = { { "expr", b.expr }, { "metric", b.metric }, { "limit", b.limit } };
+        if (!stats.contains(b.metric)) {
+            result["error"] = "unknown metric";
+            result["pass"] = false;
+            pass = false;
+        } else {
+            double value = stats[b.metric].get<double>();
+            bool ok = compare(value, b.op, b.limit);
+            result["value"] = value;
+            result["pass"] = ok;
+            pass = pass && ok;
+        }
+        results.push_back(std::move(result));
+    }
+
+    nlohmann::json report = {
+        { "pass", pass },
+        { "droppedFrames", dropped },
+        { "stoppedByMarker", stoppedByMarker },
+        { "missingMarker", missingMarker.empty() ? nlohmann::json() : nlohmann::json(missingMarker) },
+        { "stats", stats },
+        { "budgets", results },
+        { "markers", markers },
+    };
+    std::printf("%s\n", report.dump(2).c_str());
+    return pass ? 0 : 1;
+}
@@ -1,12 +1,63 @@
 import express from 'express';
 import cors from 'cors';
+import { parseArgs } from 'node:util';
+
+// ---------------------------------------------------------------------------
+// Command line: scale and churn modes for stress-testing the UI and API
+//
+//   node index.js --nodes 1000000 --fanout 8 --shape random \
+//                 --spawn-rate 200 --despawn-rate 200 --reparent-rate 50 \
+//                 --prop-changes 500 --frame-rate 60
+// ---------------------------------------------------------------------------
+const { values: args } = parseArgs({
+  options: {
+    'port': { type: 'string', default: '7700' },
+    'nodes': { type: 'string', default: '0' },          // 0 = small fixed demo scene
+    'fanout': { type: 'string', default: '8' },         // children per node
+    'shape': { type: 'string', default: 'balanced' },   // balanced | random | flat | deep
+    'depth': { type: 'string', default: '64' },         // chain length for shape=deep
+    'seed': { type: 'string', default: '42' },
+    'spawn-rate': { type: 'string', default: '0' },     // spawns per second
+    'despawn-rate': { type: 'string', default: '0' },   // despawns per second
+    'reparent-rate': { type: 'string', default: '0' },  // reparents per second
+    'prop-changes': { type: 'string', default: '0' },   // entities mutated per frame
+    'frame-rate': { type: 'string', default: '60' },    // simulated frames per second
+  },
+});
+
+const options = {
+  port: parseInt(args['port']),
+  nodes: Math.floor(Number(args['nodes'])),
+  fanout: Math.max(1, parseInt(args['fanout'])),
+  shape: args['shape'],
+  depth: Math.max(1, parseInt(args['depth'])),
+  seed: parseInt(args['seed']),
+  spawnRate: Number(args['spawn-rate']),
+  despawnRate: Number(args['despawn-rate']),
+  reparentRate: Number(args['reparent-rate']),
+  propChanges: parseInt(args['prop-changes']),
+  frameRate: Math.max(1, Number(args['frame-rate'])),
+};
 
 const app = express();
-const PORT = 7700;
+const PORT = options.port;
 
 app.use(cors());
 app.use(express.json());
 
+// Server-Timing like the C++ server's; the mock has no phases worth splitting
+app.use((req, res, next) => {
+  const start = process.hrtime.bigint();
+  const writeHead = res.writeHead;
+  res.writeHead = function (...args) {
+    const ms = Number(process.hrtime.bigint() - start) / 1e6;
+    res.setHeader('Server-Timing', `total;dur=${ms.toFixed(3)}`);
+    res.setHeader('Timing-Allow-Origin', '*');
+    return writeHead.apply(this, args);
+  };
+  next();
+});
+
 // ---------------------------------------------------------------------------
 // Deterministic pseudo-random from a seed (for stable per-entity properties)
 // ---------------------------------------------------------------------------
@@ -38,9 +89,12 @@ const NAMES = [
   'SFX_Emitter', 'ParticleFX', 'UI_Root', 'Button_Start', 'Button_Quit',
 ];
 
+// Ids are kept as numbers internally and sent as decimal strings. Numeric
+// strings with identical low bits (pointer spacing) collide in V8's Map
+// hashing, which makes lookups crawl at scale.
 let nextPtr = 0xBEEF0000;
 function makeId() {
-  const id = nextPtr.toString(10);
+  const id = nextPtr;
   nextPtr += 0x80; // simulate pointer spacing
   return id;
 }
@@ -188,90 +242,283 @@ function randomColor(rng) {
   return `#${r}${g}${b}`;
 }
 
-// Generate the scene tree
-const rng = mulberry32(42);
-const namePool = [...NAMES];
-const sceneRoots = [];
+// Small hand-shaped demo scene (default)
+function generateFixedScene(rng) {
+  const namePool = [...NAMES];
 
-// Create a "Root" container with two main branches: World and UI
-const rootChildren = [];
+  // A "Root" container with two main branches: World and UI
 
-// World branch
-const worldChildren = [];
-for (let i = 0; i < 8; i++) {
-  worldChildren.push(generateEntity(2, rng, namePool));
-}
+  // World branch
+  const worldChildren = [];
+  for (let i = 0; i < 8; i++) {
+    worldChildren.push(generateEntity(2, rng, namePool));
+  }
 
-// Add explicit zone entities for testing points2d
-function addZoneEntity(name, zoneType, points) {
-  const id = makeId();
-  const entity = {
-    id, type: 'Zone', name, children: [],
+  // Add explicit zone entities for testing points2d
+  function addZoneEntity(name, zoneType, points) {
+    const id = makeId();
+    const entity = {
+      id, type: 'Zone', name, children: [],
+      properties: [
+        { name: 'enabled', type: 'int', value: 1 },
+        { name: 'zoneType', type: 'string', value: zoneType },
+        { name: 'color', type: 'color', value: zoneType === 'patrol' ? '#4F95FF' : '#47B576' },
+        { name: zoneType === 'patrol' ? 'path' : 'boundary', type: 'points2d', value: points },
+      ],
+    };
+    entityMap.set(id, entity);
+    return { id, type: 'Zone', name, children: [] };
+  }
+  worldChildren.push(addZoneEntity('Spawn_Zone_A', 'spawn', [
+    [0, 0], [30, 0], [30, 20], [0, 20],
+  ]));
+  worldChildren.push(addZoneEntity('Combat_Area', 'trigger', [
+    [-10, -10], [50, -5], [60, 40], [30, 55], [-15, 35],
+  ]));
+  worldChildren.push(addZoneEntity('Guard_Patrol', 'patrol', [
+    [0, 0], [20, 5], [40, -10], [55, 15], [35, 30], [10, 25],
+  ]));
+  const worldId = makeId();
+  entityMap.set(worldId, {
+    id: worldId, type: 'Transform', name: 'World',
+    children: worldChildren.map(c => c.id),
+    properties: generateProperties('Transform', worldId),
+  });
+
+  // UI branch
+  const uiChildren = [];
+  for (let i = 0; i < 4; i++) {
+    uiChildren.push(generateEntity(2, rng, namePool));
+  }
+  const uiId = makeId();
+  entityMap.set(uiId, {
+    id: uiId, type: 'Canvas', name: 'UI',
+    children: uiChildren.map(c => c.id),
     properties: [
       { name: 'enabled', type: 'int', value: 1 },
-      { name: 'zoneType', type: 'string', value: zoneType },
-      { name: 'color', type: 'color', value: zoneType === 'patrol' ? '#4F95FF' : '#47B576' },
-      { name: zoneType === 'patrol' ? 'path' : 'boundary', type: 'points2d', value: points },
+      { name: 'renderMode', type: 'string', value: 'screenSpace' },
+      { name: 'sortOrder', type: 'int', value: 0 },
     ],
+  });
+
+  // Root
+  const rootId = makeId();
+  entityMap.set(rootId, {
+    id: rootId, type: 'Transform', name: 'Root',
+    children: [worldId, uiId],
+    properties: generateProperties('Transform', rootId),
+  });
+  return [rootId];
+}
+
+// Large generated scene for --nodes N. Properties are generated lazily on
+// first access so a million-node scene stays cheap to hold.
+function generateScaledScene(count, fanout, shape, depth, rng) {
+  const newNode = (parent) => {
+    const id = makeId();
+    const type = pick(rng, ENTITY_TYPES);
+    const name = rng() > 0.4 ? `${pick(rng, NAMES)}_${entityMap.size}` : null;
+    entityMap.set(id, { id, type, name, parent, children: [], properties: null });
+    if (parent) entityMap.get(parent).children.push(id);
+    return id;
   };
-  entityMap.set(id, entity);
-  return { id, type: 'Zone', name, children: [] };
-}
-worldChildren.push(addZoneEntity('Spawn_Zone_A', 'spawn', [
-  [0, 0], [30, 0], [30, 20], [0, 20],
-]));
-worldChildren.push(addZoneEntity('Combat_Area', 'trigger', [
-  [-10, -10], [50, -5], [60, 40], [30, 55], [-15, 35],
-]));
-worldChildren.push(addZoneEntity('Guard_Patrol', 'patrol', [
-  [0, 0], [20, 5], [40, -10], [55, 15], [35, 30], [10, 25],
-]));
-const worldId = makeId();
-const worldNode = { id: worldId, type: 'Transform', name: 'World', children: worldChildren };
-entityMap.set(worldId, {
-  id: worldId, type: 'Transform', name: 'World',
-  children: worldChildren.map(c => c.id),
-  properties: generateProperties('Transform', worldId),
-});
 
-// UI branch
-const uiChildren = [];
-for (let i = 0; i < 4; i++) {
-  uiChildren.push(generateEntity(2, rng, namePool));
-}
-const uiId = makeId();
-const uiNode = { id: uiId, type: 'Canvas', name: 'UI', children: uiChildren };
-entityMap.set(uiId, {
-  id: uiId, type: 'Canvas', name: 'UI',
-  children: uiChildren.map(c => c.id),
-  properties: [
-    { name: 'enabled', type: 'int', value: 1 },
-    { name: 'renderMode', type: 'string', value: 'screenSpace' },
-    { name: 'sortOrder', type: 'int', value: 0 },
-  ],
-});
+  const rootId = newNode(null);
+  if (shape === 'flat') {
+    while (entityMap.size < count) newNode(rootId);
+  } else if (shape === 'deep') {
+    // Chains of `depth` nodes hanging off the root
+    let tail = rootId;
+    let length = 0;
+    while (entityMap.size < count) {
+      if (length === depth) { tail = rootId; length = 0; }
+      tail = newNode(tail);
+      length++;
+    }
+  } else {
+    // Breadth-first: `balanced` gives every node `fanout` children,
+    // `random` gives 0..2*fanout so the tree is ragged
+    const queue = [rootId];
+    for (let head = 0; head < queue.length && entityMap.size < count; head++) {
+      const n = shape === 'random' ? Math.floor(rng() * (fanout * 2 + 1)) : fanout;
+      for (let i = 0; i < n && entityMap.size < count; i++) {
+        queue.push(newNode(queue[head]));
+      }
+    }
+  }
+  return [rootId];
+}
 
-// Root
-const rootId = makeId();
-const rootNode = { id: rootId, type: 'Transform', name: 'Root', children: [worldNode, uiNode] };
-entityMap.set(rootId, {
-  id: rootId, type: 'Transform', name: 'Root',
-  children: [worldId, uiId],
-  properties: generateProperties('Transform', rootId),
-});
-sceneRoots.push(rootNode);
+const rng = mulberry32(options.seed);
+const rootIds = options.nodes > 0
+  ? generateScaledScene(options.nodes, options.fanout, options.shape, options.depth, rng)
+  : generateFixedScene(rng);
+
+// Parent links and a dense id array for O(1) random picks during churn
+const allIds = [];
+const idIndex = new Map();
+for (const [id, entity] of entityMap) {
+  if (entity.parent === undefined) entity.parent = null;
+  for (const child of entity.children) entityMap.get(child).parent = id;
+  idIndex.set(id, allIds.length);
+  allIds.push(id);
+}
+
+function entityProperties(entity) {
+  if (!entity.properties) entity.properties = generateProperties(entity.type, entity.id);
+  return entity.properties;
+}
 
-// Build tree response (recursive, only id/type/name/children)
-function toTreeNode(node) {
+// ---------------------------------------------------------------------------
+// Scene serialization: cached per generation, rebuilt only after churn
+// ---------------------------------------------------------------------------
+let sceneGeneration = 0;
+let sceneBody = null;
+let sceneBodyGeneration = -1;
+
+// Build tree response (recursive, only id/type/name/children). Plain objects
+// through JSON.stringify beat hand-concatenated strings at this size.
+function toTreeNode(id) {
+  const e = entityMap.get(id);
   return {
-    id: node.id,
-    type: node.type,
-    name: node.name,
-    children: (node.children || []).map(c => typeof c === 'string' ? null : toTreeNode(c)).filter(Boolean),
+    id: String(id),
+    type: e.type,
+    name: e.name ?? null,
+    children: e.children.map(toTreeNode),
   };
 }
 
-const sceneTree = { entities: sceneRoots.map(toTreeNode) };
+// Parked /api/scene?wait=&since= requests, answered on the next structural
+// change or when their wait expires. Versions are generation + 1, matching
+// the C++ server's generations, which start at 1.
+const sceneWaiters = new Set();
+const MAX_WAIT_MS = 60000;
+
+function sceneVersion() {
+  return sceneGeneration + 1;
+}
+
+function sendScene(res, status) {
+  res.set('X-Reflector-Version', String(sceneVersion()));
+  res.set('Access-Control-Expose-Headers', 'X-Reflector-Version');
+  if (status === 304) return res.status(304).end();
+  res.type('json').send(sceneJson());
+}
+
+function releaseSceneWaiters() {
+  for (const waiter of sceneWaiters) {
+    clearTimeout(waiter.timer);
+    sendScene(waiter.res, 200);
+  }
+  sceneWaiters.clear();
+}
+
+function sceneJson() {
+  if (sceneBodyGeneration !== sceneGeneration) {
+    sceneBody = JSON.stringify({ entities: rootIds.map(toTreeNode) });
+    sceneBodyGeneration = sceneGeneration;
+  }
+  return sceneBody;
+}
+
+// ---------------------------------------------------------------------------
+// Churn simulation: spawns, despawns, reparents and property changes,
+// applied once per simulated frame
+// ---------------------------------------------------------------------------
+const churn = { spawn: 0, despawn: 0, reparent: 0 };
+const churnRng = mulberry32(options.seed + 1);
+
+function randomEntityId() {
+  return allIds[Math.floor(churnRng() * allIds.length)];
+}
+
+function trackId(id) {
+  idIndex.set(id, allIds.length);
+  allIds.push(id);
+}
+
+function untrackId(id) {
+  const idx = idIndex.get(id);
+  const last = allIds.pop();
+  if (last !== id) {
+    allIds[idx] = last;
+    idIndex.set(last, idx);
+  }
+  idIndex.delete(id);
+}
+
+function detach(entity) {
+  const siblings = entityMap.get(entity.parent).children;
+  siblings.splice(siblings.indexOf(entity.id), 1);
+}
+
+function spawnOne() {
+  const parent = randomEntityId();
+  const id = makeId();
+  const type = pick(churnRng, ENTITY_TYPES);
+  const name = churnRng() > 0.4 ? `${pick(churnRng, NAMES)}_spawned` : null;
+  entityMap.set(id, { id, type, name, parent, children: [], properties: null });
+  entityMap.get(parent).children.push(id);
+  trackId(id);
+}
+
+function despawnOne() {
+  const entity = entityMap.get(randomEntityId());
+  if (!entity.parent) return; // roots stay
+  detach(entity);
+  const stack = [entity.id];
+  while (stack.length) {
+    const id = stack.pop();
+    stack.push(...entityMap.get(id).children);
+    entityMap.delete(id);
+    untrackId(id);
+  }
+}
+
+function reparentOne() {
+  const entity = entityMap.get(randomEntityId());
+  const target = randomEntityId();
+  if (!entity.parent) return;
+  // Reject moves into the entity's own subtree
+  for (let p = target; p; p = entityMap.get(p).parent) {
+    if (p === entity.id) return;
+  }
+  detach(entity);
+  entity.parent = target;
+  entityMap.get(target).children.push(entity.id);
+}
+
+function mutateProperties(count) {
+  for (let i = 0; i < count; i++) {
+    const props = entityProperties(entityMap.get(randomEntityId()));
+    for (const p of props) {
+      if (p.type === 'float') p.value = round(p.value + (churnRng() - 0.5) * 2);
+    }
+  }
+}
+
+function simulateFrame() {
+  const dt = 1 / options.frameRate;
+  churn.spawn += options.spawnRate * dt;
+  churn.despawn += options.despawnRate * dt;
+  churn.reparent += options.reparentRate * dt;
+
+  let structural = false;
+  for (; churn.spawn >= 1; churn.spawn--, structural = true) spawnOne();
+  for (; churn.despawn >= 1 && allIds.length > rootIds.length; churn.despawn--, structural = true) despawnOne();
+  for (; churn.reparent >= 1; churn.reparent--, structural = true) reparentOne();
+  if (structural) {
+    sceneGeneration++;
+    releaseSceneWaiters();
+  }
+
+  mutateProperties(options.propChanges);
+  merkleMemo.clear();
+}
+
+if (options.spawnRate || options.despawnRate || options.reparentRate || options.propChanges) {
+  setInterval(simulateFrame, 1000 / options.frameRate);
+}
 
 // ---------------------------------------------------------------------------
 // Perf simulation
@@ -292,6 +539,396 @@ function currentPerf() {
   };
 }
 
+// Per-frame history for /api/perf/frames: frames tick at --frame-rate since
+// startup, each with a deterministic jittered frame time
+const FRAME_HISTORY_SIZE = 8192;
+const startTime = Date.now();
+
+function simulatedFrameTime(frame) {
+  const rng = mulberry32(frame);
+  const jitter = (Math.sin(frame * 0.05) * 1.5) + (rng() - 0.5) * 2;
+  const spike = rng() > 0.98 ? rng() * 12 : 0;
+  return Math.round(Math.max(1, BASE_FRAME_TIME + jitter + spike) * 100) / 100;
+}
+
+function framesSince(since) {
+  const latest = Math.floor((Date.now() - startTime) * options.frameRate / 1000);
+  const first = Math.max(since + 1, latest - FRAME_HISTORY_SIZE + 1, 1);
+  const frameTimeMs = [];
+  for (let f = first; f <= latest; f++) frameTimeMs.push(simulatedFrameTime(f));
+  return {
+    latest,
+    first,
+    dropped: Math.max(0, first - (since + 1)),
+    frameTimeMs,
+    markers: [],
+    rssBytes: process.memoryUsage().rss,
+  };
+}
+
+// Pacing stats for /api/perf/pacing, computed the way the C++ server does but
+// without its incremental bookkeeping: the simulated frames are replayed up to
+// now on each request (the median is refreshed every 64 frames once the
+// window has filled past that).
+const PACING_WINDOW = 1024;
+const PACING_MIN_FRAMES = 16;
+const PACING_TARGET_HZ = 60;
+const pacing = {
+  processed: 0, window: [], median: 0, lastMs: 0, streak: 0,
+  total: { frames: 0, hitches: 0, missedSlots: 0, longestBadStreak: 0 },
+};
+
+function windowMedian(frames) {
+  const sorted = frames.map(f => f.ms).sort((a, b) => a - b);
+  return sorted[Math.floor((sorted.length - 1) / 2)] ?? 0;
+}
+
+function pacingNow() {
+  const latest = Math.floor((Date.now() - startTime) * options.frameRate / 1000);
+  const slotMs = 1000 / PACING_TARGET_HZ;
+  for (let f = Math.max(pacing.processed + 1, latest - PACING_WINDOW * 4); f <= latest; f++) {
+    const ms = simulatedFrameTime(f);
+    if (f % 64 === 0 || pacing.window.length < 64) pacing.median = windowMedian(pacing.window);
+    const hitch = pacing.window.length >= PACING_MIN_FRAMES && ms > 2 * pacing.median;
+    const missed = Math.max(0, Math.floor(ms / slotMs + 0.5) - 1);
+    const delta = pacing.total.frames ? ms - pacing.lastMs : 0;
+    pacing.lastMs = ms;
+    pacing.window.push({ ms, delta, hitch, missed });
+    if (pacing.window.length > PACING_WINDOW) pacing.window.shift();
+
+    const t = pacing.total;
+    t.frames++;
+    t.hitches += hitch;
+    t.missedSlots += missed;
+    pacing.streak = hitch || missed ? pacing.streak + 1 : 0;
+    t.longestBadStreak = Math.max(t.longestBadStreak, pacing.streak);
+  }
+  pacing.processed = latest;
+
+  const w = pacing.window;
+  const n = w.length || 1;
+  const mean = w.reduce((a, f) => a + f.ms, 0) / n;
+  const deltaMean = w.reduce((a, f) => a + f.delta, 0) / n;
+  const variance = Math.max(0, w.reduce((a, f) => a + f.delta * f.delta, 0) / n - deltaMean * deltaMean);
+  return {
+    window: w.length,
+    targetHz: PACING_TARGET_HZ,
+    meanMs: mean,
+    medianMs: windowMedian(w),
+    frameToFrameVariance: variance,
+    frameToFrameStdDevMs: Math.sqrt(variance),
+    hitches: w.filter(f => f.hitch).length,
+    missedSlots: w.reduce((a, f) => a + f.missed, 0),
+    badFrames: w.filter(f => f.hitch || f.missed).length,
+    currentBadStreak: pacing.streak,
+    total: { ...pacing.total },
+  };
+}
+
+// Named loops for /api/loops: iteration k of each loop starts at a fixed
+// cadence since startup and lasts a seeded, jittered duration
+const LOOP_HISTORY_SIZE = 4096;
+const LOOPS = [
+  { name: 'simulation', targetHz: 60, phaseMs: 0, baseMs: 4, seed: 101 },
+  { name: 'network', targetHz: 20, phaseMs: 7, baseMs: 2.5, seed: 202 },
+  { name: 'streaming', targetHz: 10, phaseMs: 30, baseMs: 22, seed: 303 },
+];
+
+function loopSpan(loop, k) {
+  const rng = mulberry32(loop.seed * 1000003 + k);
+  const beginMs = loop.phaseMs + (k - 1) * 1000 / loop.targetHz;
+  const durationMs = Math.round(loop.baseMs * (0.8 + rng() * 0.4 + (rng() > 0.97 ? 2 : 0)) * 1000) / 1000;
+  return { beginMs, durationMs };
+}
+
+// Iterations completed by now: spans are numbered from 1
+function loopLatest(loop, nowMs) {
+  let k = Math.max(0, Math.floor((nowMs - loop.phaseMs) * loop.targetHz / 1000) + 1);
+  while (k > 0 && loopSpan(loop, k).beginMs + loopSpan(loop, k).durationMs > nowMs) k--;
+  return k;
+}
+
+function loopFrames(loop, since) {
+  const latest = loopLatest(loop, Date.now() - startTime);
+  const first = Math.max(since + 1, latest - LOOP_HISTORY_SIZE + 1, 1);
+  const beginMs = [];
+  const durationMs = [];
+  for (let k = first; k <= latest; k++) {
+    const span = loopSpan(loop, k);
+    beginMs.push(span.beginMs);
+    durationMs.push(span.durationMs);
+  }
+  return { latest, first, dropped: Math.max(0, first - (since + 1)), beginMs, durationMs };
+}
+
+function loopsSummary(windowMs) {
+  const nowMs = Date.now() - startTime;
+  const from = nowMs - windowMs;
+  const spans = LOOPS.map((loop) => {
+    const out = [];
+    for (let k = loopLatest(loop, nowMs); k > 0; k--) {
+      const span = loopSpan(loop, k);
+      if (span.beginMs + span.durationMs <= from) break;
+      out.unshift({ begin: Math.max(span.beginMs, from), end: span.beginMs + span.durationMs });
+    }
+    return out;
+  });
+
+  const loops = LOOPS.map((loop, i) => {
+    const s = spans[i];
+    const durations = s.map(span => span.end - span.begin);
+    const busy = durations.reduce((a, d) => a + d, 0);
+    return {
+      name: loop.name,
+      targetHz: loop.targetHz,
+      latest: loopLatest(loop, nowMs),
+      iterations: s.length,
+      rateHz: s.length > 1 ? (s.length - 1) * 1000 / (s[s.length - 1].begin - s[0].begin) : 0,
+      avgMs: s.length ? busy / s.length : 0,
+      maxMs: durations.length ? Math.max(...durations) : 0,
+      busy: busy / windowMs,
+    };
+  });
+
+  // Sweep over begin/end events (ends first on ties)
+  const events = [];
+  spans.forEach((s, i) => s.forEach((span) => {
+    events.push({ t: span.begin, loop: i, begin: true });
+    events.push({ t: span.end, loop: i, begin: false });
+  }));
+  events.sort((a, b) => a.t - b.t || a.begin - b.begin);
+  const active = new Set();
+  const pairMs = new Map();
+  let concurrentMs = 0;
+  let last = from;
+  for (const e of events) {
+    const dt = e.t - last;
+    if (dt > 0 && active.size > 1) {
+      concurrentMs += dt;
+      const list = [...active].sort();
+      for (let a = 0; a < list.length; a++) {
+        for (let b = a + 1; b < list.length; b++) {
+          const key = `${list[a]},${list[b]}`;
+          pairMs.set(key, (pairMs.get(key) ?? 0) + dt);
+        }
+      }
+    }
+    last = e.t;
+    if (e.begin) active.add(e.loop);
+    else active.delete(e.loop);
+  }
+
+  const pairs = [];
+  for (let a = 0; a < LOOPS.length; a++) {
+    for (let b = a + 1; b < LOOPS.length; b++) {
+      pairs.push({ a: LOOPS[a].name, b: LOOPS[b].name, overlapMs: pairMs.get(`${a},${b}`) ?? 0 });
+    }
+  }
+  return { windowMs, loops, overlap: { concurrentMs, pairs } };
+}
+
+// Gauges for /api/gauges: sample k of each gauge is taken on its own cadence
+// since startup, a few tens of microseconds late, with a seeded value
+const GAUGE_HISTORY_SIZE = 4096;
+const GAUGES = [
+  { name: 'pool.occupancy', targetHz: 10, seed: 11, value: (k, r) => Math.round(600 + 300 * Math.sin(k / 40) + r * 50) },
+  { name: 'network.queue', targetHz: 20, seed: 22, value: (k, r) => Math.floor(r * r * 32) },
+  { name: 'streaming.residentMb', targetHz: 5, seed: 33, value: (k, r) => Math.round((512 + (k % 300) * 1.5 + r * 8) * 10) / 10 },
+];
+
+function gaugeSample(gauge, k) {
+  const rng = mulberry32(gauge.seed * 1000003 + k);
+  const timeMs = (k - 1) * 1000 / gauge.targetHz + rng() * 0.08;
+  return { timeMs: Math.round(timeMs * 1000) / 1000, value: gauge.value(k, rng()) };
+}
+
+function gaugeLatest(gauge, nowMs) {
+  let k = Math.max(0, Math.floor(nowMs * gauge.targetHz / 1000) + 1);
+  while (k > 0 && gaugeSample(gauge, k).timeMs > nowMs) k--;
+  return k;
+}
+
+function gaugeSamples(gauge, since) {
+  const latest = gaugeLatest(gauge, Date.now() - startTime);
+  const first = Math.max(since + 1, latest - GAUGE_HISTORY_SIZE + 1, 1);
+  const timeMs = [];
+  const values = [];
+  for (let k = first; k <= latest; k++) {
+    const sample = gaugeSample(gauge, k);
+    timeMs.push(sample.timeMs);
+    values.push(sample.value);
+  }
+  return { latest, first, dropped: Math.max(0, first - (since + 1)), timeMs, values };
+}
+
+function gaugesSummary() {
+  const nowMs = Date.now() - startTime;
+  return {
+    gauges: GAUGES.map((gauge) => {
+      const latest = gaugeLatest(gauge, nowMs);
+      const first = Math.max(1, latest - GAUGE_HISTORY_SIZE + 1);
+      const periodMs = 1000 / gauge.targetHz;
+      let sq = 0;
+      for (let k = first + 1; k <= latest; k++) {
+        const d = gaugeSample(gauge, k).timeMs - gaugeSample(gauge, k - 1).timeMs - periodMs;
+        sq += d * d;
+      }
+      const n = latest - first;
+      return {
+        name: gauge.name,
+        targetHz: gauge.targetHz,
+        latest,
+        value: latest ? gaugeSample(gauge, latest).value : null,
+        rateHz: n > 0 ? n * 1000 / (gaugeSample(gauge, latest).timeMs - gaugeSample(gauge, first).timeMs) : 0,
+        jitterMs: n > 0 ? Math.sqrt(sq / n) : 0,
+        skipped: 0,
+      };
+    }),
+  };
+}
+
+// Job graph for /api/jobs: frame k of a 60 Hz frame graph, list-scheduled
+// onto the workers with seeded job durations. Worker 0 is the main thread,
+// which only spawns.
+const JOB_GRAPH = { name: 'frame', workers: 5, targetHz: 60, seed: 404, history: 4096 };
+const JOB_TEMPLATE = [
+  { name: 'input', baseMs: 0.3, deps: [] },
+  ...[0, 1, 2, 3].map(i => ({ name: 'physics', baseMs: 1.6, deps: ['input'], chunk: i })),
+  ...[0, 1, 2, 3].map(i => ({ name: 'animation', baseMs: 0.9, deps: ['physics'], chunk: i })),
+  { name: 'ai', baseMs: 2.4, deps: ['input'] },
+  { name: 'culling', baseMs: 1.1, deps: ['animation'] },
+  { name: 'render.submit', baseMs: 2.2, deps: ['culling', 'ai'] },
+  { name: 'audio', baseMs: 0.7, deps: [] },
+];
+const JOB_GAP_MIN_MS = 0.01;
+const JOB_GAPS_LISTED = 16;
+
+function jobFrameSpan(k) {
+  return { beginMs: (k - 1) * 1000 / JOB_GRAPH.targetHz };
+}
+
+function scheduleJobFrame(k) {
+  const rng = mulberry32(JOB_GRAPH.seed * 1000003 + k);
+  const frameBegin = jobFrameSpan(k).beginMs;
+  const free = new Array(JOB_GRAPH.workers).fill(frameBegin + 0.05);
+  free[0] = Infinity; // main thread
+  const runs = [];
+  const byName = new Map();
+  JOB_TEMPLATE.forEach((t, i) => {
+    const prereqs = t.deps.flatMap(d => byName.get(d) ?? []);
+    const ready = Math.max(frameBegin, ...prereqs.map(p => runs[p].endMs));
+    let worker = 1;
+    for (let w = 2; w < free.length; w++) {
+      if (Math.max(free[w], ready) < Math.max(free[worker], ready)) worker = w;
+    }
+    const startMs = Math.max(free[worker], ready) + 0.01 + rng() * 0.04;
+    const durationMs = t.baseMs * (0.8 + rng() * 0.4 + (rng() > 0.97 ? 1.5 : 0));
+    const endMs = startMs + durationMs;
+    free[worker] = endMs;
+    runs.push({ id: String(1000 + i), name: t.name, worker, spawnMs: frameBegin, startMs, endMs, prereqs });
+    byName.set(t.name, [...(byName.get(t.name) ?? []), i]);
+  });
+  const endMs = Math.max(...runs.map(r => r.endMs)) + 0.05;
+  return { beginMs: frameBegin, endMs, runs };
+}
+
+function jobFrameLatest(nowMs) {
+  let k = Math.max(0, Math.floor(nowMs * JOB_GRAPH.targetHz / 1000) + 1);
+  while (k > 0 && scheduleJobFrame(k).endMs > nowMs) k--;
+  return k;
+}
+
+function jobFrameReport(k, latest) {
+  const frame = scheduleJobFrame(k);
+  const { runs } = frame;
+  const frameMs = frame.endMs - frame.beginMs;
+  const at = ms => ms - frame.beginMs;
+
+  // Start order is topological, as on the server
+  const order = runs.map((_, i) => i).sort((a, b) => runs[a].startMs - runs[b].startMs);
+  const chain = new Array(runs.length).fill(0);
+  const via = new Array(runs.length).fill(-1);
+  const ready = new Array(runs.length).fill(0);
+  let workMs = 0;
+  let last = -1;
+  for (const r of order) {
+    ready[r] = Math.max(runs[r].spawnMs, frame.beginMs);
+    let best = 0;
+    for (const p of runs[r].prereqs) {
+      ready[r] = Math.max(ready[r], runs[p].endMs);
+      if (chain[p] > best) {
+        best = chain[p];
+        via[r] = p;
+      }
+    }
+    const d = runs[r].endMs - runs[r].startMs;
+    chain[r] = best + d;
+    workMs += d;
+    if (last < 0 || chain[r] > chain[last]) last = r;
+  }
+  const path = [];
+  for (let r = last; r >= 0; r = via[r]) path.unshift(r);
+
+  const gaps = [];
+  let busyTotal = 0;
+  const workers = [];
+  for (let w = 0; w < JOB_GRAPH.workers; w++) {
+    const spans = runs.filter(r => r.worker === w).sort((a, b) => a.startMs - b.startMs);
+    let cursor = frame.beginMs;
+    let busyMs = 0;
+    let count = 0;
+    let longestGapMs = 0;
+    const idle = (until) => {
+      const ms = until - cursor;
+      if (ms < JOB_GAP_MIN_MS) return;
+      gaps.push({ worker: w, startMs: at(cursor), durationMs: ms });
+      longestGapMs = Math.max(longestGapMs, ms);
+      count++;
+    };
+    for (const s of spans) {
+      if (s.endMs <= cursor) continue;
+      idle(Math.max(s.startMs, cursor));
+      busyMs += s.endMs - Math.max(s.startMs, cursor);
+      cursor = s.endMs;
+    }
+    idle(frame.endMs);
+    busyTotal += busyMs;
+    workers.push({ worker: w, jobs: spans.length, busyMs, utilization: busyMs / frameMs, gaps: count, longestGapMs });
+  }
+  gaps.sort((a, b) => b.durationMs - a.durationMs);
+
+  const span = last < 0 ? 0 : chain[last];
+  return {
+    graph: JOB_GRAPH.name,
+    frame: k,
+    latest,
+    beginMs: frame.beginMs,
+    durationMs: frameMs,
+    complete: true,
+    jobs: runs.length,
+    pending: 0,
+    unfinished: 0,
+    edges: runs.reduce((a, r) => a + r.prereqs.length, 0),
+    workMs,
+    criticalPath: {
+      durationMs: span,
+      waitMs: path.reduce((a, r) => a + Math.max(runs[r].startMs - ready[r], 0), 0),
+      parallelism: span ? workMs / span : 0,
+      jobs: path.map(r => ({
+        id: runs[r].id,
+        name: runs[r].name,
+        worker: runs[r].worker,
+        startMs: at(runs[r].startMs),
+        durationMs: runs[r].endMs - runs[r].startMs,
+        waitMs: Math.max(runs[r].startMs - ready[r], 0),
+      })),
+    },
+    workers,
+    utilization: busyTotal / (frameMs * JOB_GRAPH.workers),
+    gaps: gaps.slice(0, JOB_GAPS_LISTED),
+  };
+}
+
 // ---------------------------------------------------------------------------
 // Routes
 // ---------------------------------------------------------------------------
@@ -299,16 +936,182 @@ app.get('/api/perf', (_req, res) => {
   res.json(currentPerf());
 });
 
-app.get('/api/scene', (_req, res) => {
-  res.json(sceneTree);
+app.get('/api/perf/frames', (req, res) => {
+  res.json(framesSince(parseInt(req.query.since) || 0));
+});
+
+app.get('/api/perf/pacing', (_req, res) => {
+  res.json(pacingNow());
+});
+
+app.get('/api/loops', (req, res) => {
+  const windowMs = Math.min(60000, Math.max(1, parseInt(req.query.windowMs) || 1000));
+  res.json(loopsSummary(windowMs));
+});
+
+app.get('/api/loops/:name/frames', (req, res) => {
+  const loop = LOOPS.find(l => l.name === req.params.name);
+  if (!loop) {
+    return res.status(404).json({ error: 'Loop not found' });
+  }
+  res.json(loopFrames(loop, parseInt(req.query.since) || 0));
+});
+
+app.get('/api/jobs', (_req, res) => {
+  const latest = jobFrameLatest(Date.now() - startTime);
+  res.json({
+    graphs: [{
+      name: JOB_GRAPH.name,
+      workers: JOB_GRAPH.workers,
+      latest,
+      lastFrameMs: latest ? scheduleJobFrame(latest).endMs - scheduleJobFrame(latest).beginMs : null,
+    }],
+  });
+});
+
+app.get('/api/jobs/:name', (req, res) => {
+  if (req.params.name !== JOB_GRAPH.name) {
+    return res.status(404).json({ error: 'Job graph not found' });
+  }
+  const latest = jobFrameLatest(Date.now() - startTime);
+  const frame = req.query.frame !== undefined ? parseInt(req.query.frame) || 0 : latest;
+  if (frame < 1 || frame > latest || frame <= latest - JOB_GRAPH.history) {
+    return res.status(404).json({ error: 'Frame not available' });
+  }
+  res.json(jobFrameReport(frame, latest));
+});
+
+app.get('/api/gauges', (_req, res) => {
+  res.json(gaugesSummary());
+});
+
+app.get('/api/gauges/:name', (req, res) => {
+  const gauge = GAUGES.find(g => g.name === req.params.name);
+  if (!gauge) {
+    return res.status(404).json({ error: 'Gauge not found' });
+  }
+  res.json(gaugeSamples(gauge, parseInt(req.query.since) || 0));
+});
+
+app.get('/api/scene', (req, res) => {
+  const since = parseInt(req.query.since);
+  const wait = Math.min(MAX_WAIT_MS, parseInt(req.query.wait) || 0);
+  if (Number.isNaN(since) || wait <= 0 || since !== sceneVersion()) {
+    return sendScene(res, 200);
+  }
+  const waiter = { res };
+  waiter.timer = setTimeout(() => {
+    sceneWaiters.delete(waiter);
+    sendScene(res, 304);
+  }, wait);
+  sceneWaiters.add(waiter);
+  res.on('close', () => {
+    clearTimeout(waiter.timer);
+    sceneWaiters.delete(waiter);
+  });
 });
 
 app.get('/api/entity/:id', (req, res) => {
-  const entity = entityMap.get(req.params.id);
+  const entity = entityMap.get(Number(req.params.id));
   if (!entity) {
     return res.status(404).json({ error: 'Entity not found' });
   }
-  res.json({ properties: entity.properties });
+  res.json({ properties: entityProperties(entity) });
+});
+
+// Merkle summaries: subtree hashes over types, names, child order and
+// properties (not ids), memoized until the next simulated frame. The mock's
+// hashes only compare against other mock instances, not the C++ server's.
+const merkleMemo = new Map(); // id -> { hash, entity, size }
+
+function hash53(str) {
+  let h1 = 0xdeadbeef, h2 = 0x41c6ce57;
+  for (let i = 0; i < str.length; i++) {
+    const c = str.charCodeAt(i);
+    h1 = Math.imul(h1 ^ c, 2654435761);
+    h2 = Math.imul(h2 ^ c, 1597334677);
+  }
+  h1 = Math.imul(h1 ^ (h1 >>> 16), 2246822507) ^ Math.imul(h2 ^ (h2 >>> 13), 3266489909);
+  h2 = Math.imul(h2 ^ (h2 >>> 16), 2246822507) ^ Math.imul(h1 ^ (h1 >>> 13), 3266489909);
+  return (h2 >>> 0).toString(16).padStart(8, '0') + (h1 >>> 0).toString(16).padStart(8, '0');
+}
+
+function merkleNode(id) {
+  let m = merkleMemo.get(id);
+  if (m) return m;
+  const e = entityMap.get(id);
+  const children = e.children.map(merkleNode);
+  const entity = hash53(JSON.stringify(entityProperties(e)));
+  m = {
+    hash: hash53([e.type, e.name ?? '', entity, ...children.map(c => c.hash)].join('\0')),
+    entity,
+    size: children.reduce((n, c) => n + c.size, 1),
+  };
+  merkleMemo.set(id, m);
+  return m;
+}
+
+function merkleSummary(id, index) {
+  const e = entityMap.get(id);
+  const m = merkleNode(id);
+  return { index, hash: m.hash, size: m.size, id: String(id), type: e.type, name: e.name ?? null, entity: m.entity };
+}
+
+app.get('/api/merkle', (req, res) => {
+  const path = String(req.query.path ?? '');
+  let children = rootIds;
+  let node = null;
+  for (const part of path ? path.split('/') : []) {
+    const index = /^\d+$/.test(part) ? Number(part) : -1;
+    if (index < 0 || index >= children.length) return res.status(404).json({ error: 'No node at path' });
+    node = children[index];
+    children = entityMap.get(node).children;
+  }
+  const frame = framesSince(Number.MAX_SAFE_INTEGER).latest;
+  const self = node === null
+    ? { hash: hash53(rootIds.map(id => merkleNode(id).hash).join('\0')), size: rootIds.reduce((n, id) => n + merkleNode(id).size, 0) }
+    : merkleSummary(node);
+  delete self.index;
+  res.json({ path, frame, ...self, children: children.map(merkleSummary) });
+});
+
+// Several reads in one round trip. The mock is single-threaded, so every
+// result comes from the same simulated frame. It has no worlds and sends no
+// ETags, so "world" always 404s and "ifNoneMatch" is ignored.
+function batchResult(sub, frame) {
+  if (!sub || typeof sub !== 'object' || Array.isArray(sub)) {
+    return { status: 400, frame: null, body: { error: 'Sub-request must be an object' } };
+  }
+  if (sub.world !== undefined) {
+    return { status: 404, frame: null, body: { error: 'World not found' } };
+  }
+  switch (sub.op) {
+  case 'perf':
+    return { status: 200, frame, body: currentPerf() };
+  case 'frames':
+    return { status: 200, frame, body: framesSince(Number.isInteger(sub.since) ? sub.since : 0) };
+  case 'pacing':
+    return { status: 200, frame, body: pacingNow() };
+  case 'scene':
+    return { status: 200, frame, body: JSON.parse(sceneJson()) };
+  case 'entity': {
+    const entity = entityMap.get(Number(sub.id));
+    return entity
+      ? { status: 200, frame, body: { properties: entityProperties(entity) } }
+      : { status: 404, frame, body: { error: 'Entity not found' } };
+  }
+  default:
+    return { status: 400, frame: null, body: { error: 'Unknown op' } };
+  }
+}
+
+app.post('/api/batch', (req, res) => {
+  const batch = req.body;
+  if (!Array.isArray(batch) || batch.length > 64) {
+    return res.status(400).json({ error: 'Expected an array of at most 64 sub-requests' });
+  }
+  const frame = framesSince(Number.MAX_SAFE_INTEGER).latest;
+  res.json({ consistent: true, results: batch.map(sub => batchResult(sub, frame)) });
 });
 
 // ---------------------------------------------------------------------------
@@ -317,4 +1120,9 @@ app.get('/api/entity/:id', (req, res) => {
 app.listen(PORT, () => {
   console.log(`[reflector] Mock server running on http://localhost:${PORT}`);
   console.log(`[reflector] ${entityMap.size} entities generated`);
+  if (options.spawnRate || options.despawnRate || options.reparentRate || options.propChanges) {
+    console.log(`[reflector] churn @ ${options.frameRate} fps: ${options.spawnRate} spawns/s, ` +
+      `${options.despawnRate} despawns/s, ${options.reparentRate} reparents/s, ` +
+      `${options.propChanges} property changes/frame`);
+  }
 });
@@ -1,17 +1,44 @@
-import { ref, readonly, onUnmounted } from 'vue';
+import { ref, shallowRef, readonly, shallowReadonly, onUnmounted } from 'vue';
+import { PerfRing } from './perfRing.js';
 
 const POLL_INTERVAL = 2000;
 const PERF_POLL_INTERVAL = 500;
-const PERF_HISTORY_SIZE = 200;
+const PERF_HISTORY_SIZE = 4096;
+const LOOP_HISTORY_SIZE = 1024;
+const GAUGE_HISTORY_SIZE = 1024;
+const ENTITY_CACHE_SIZE = 64;
+const ENTITY_FRESH_MS = 2000; // cached entities younger than this are used as is
+const PREFETCH_SIBLINGS = 2;  // on each side of the selection
 
 // Shared reactive state
 const connected = ref(false);
 const perf = ref(null);
-const perfHistory = ref([]);
-const scene = ref(null);
+// Frame times: every frame from /api/perf/frames when the app records them,
+// otherwise one /api/perf sample per poll. Not reactive; `perfVersion` bumps
+// after each batch of pushes.
+const perfHistory = new PerfRing(PERF_HISTORY_SIZE);
+const perfVersion = ref(0);
+let lastFrame = 0;          // last frame number pulled from /api/perf/frames
+let framesSupported = true; // false once the server lacks /api/perf/frames
+// Named loops from /api/loops: per-loop summaries (republished each poll)
+// with a ring of iteration durations, plus how the loops overlapped
+const loops = shallowRef([]);
+const loopOverlap = shallowRef(null);
+const loopRings = new Map(); // name -> { ring: PerfRing, last: iteration number }
+let loopsSupported = true;   // false once the server lacks /api/loops
+// Gauges from /api/gauges: summaries with a ring of the values sampled
+// server-side since the last pull
+const gauges = shallowRef([]);
+const gaugeRings = new Map(); // name -> { ring: PerfRing, last: sample number }
+let gaugesSupported = true;   // false once the server lacks /api/gauges
+// { roots: string[], nodes: Map<id, { id, parentId, type, name, children: id[] }>, version }
+// Held in a shallowRef: the node table is patched in place and republished
+// by swapping the wrapper, so Vue never deep-tracks the hierarchy.
+const scene = shallowRef(null);
 
 let pollTimer = null;
 let perfTimer = null;
+let perfPoll = null; // in-flight pollPerf(), shared by both timers
 
 async function fetchJson(url) {
   const res = await fetch(url);
@@ -24,9 +51,7 @@ async function fetchJson(url) {
 // ---------------------------------------------------------------------------
 async function pollConnection() {
   try {
-    const data = await fetchJson('/api/perf');
-    perf.value = data;
-    pushPerfSample(data.frameTimeMs);
+    await pollPerf();
 
     if (!connected.value) {
       connected.value = true;
@@ -34,32 +59,137 @@ async function pollConnection() {
       await refreshScene();
       // Start fast perf polling
       startPerfPolling();
+    } else {
+      // Keep the tree current; the worker only sends what changed
+      refreshScene();
     }
   } catch {
     if (connected.value) {
       connected.value = false;
       perf.value = null;
-      scene.value = null;
+      lastFrame = 0;
+      framesSupported = true;
+      clearLoops();
+      clearGauges();
+      clearScene();
+      clearEntities();
       stopPerfPolling();
     }
   }
 }
 
-function pushPerfSample(frameTimeMs) {
-  const hist = perfHistory.value;
-  if (hist.length >= PERF_HISTORY_SIZE) {
-    hist.shift();
+function pollPerf() {
+  // Coalesce: the connection and perf timers both poll, and overlapping pulls
+  // would ask for the same frames, iterations and samples and push them twice
+  if (!perfPoll) {
+    perfPoll = pullPerf().finally(() => { perfPoll = null; });
   }
-  hist.push(frameTimeMs);
+  return perfPoll;
+}
+
+async function pullPerf() {
+  const data = await fetchJson('/api/perf');
+  perf.value = data;
+  if (!(await pullFrames())) {
+    perfHistory.push(data.frameTimeMs);
+  }
+  await Promise.all([pullLoops(), pullGauges()]);
+  perfVersion.value++;
+}
+
+// Append every frame recorded since the last pull. Returns false when the
+// server has no per-frame data, so the caller falls back to /api/perf.
+async function pullFrames() {
+  if (!framesSupported) return false;
+  let data;
+  try {
+    data = await fetchJson(`/api/perf/frames?since=${lastFrame}`);
+  } catch {
+    framesSupported = false;
+    return false;
+  }
+  if (data.latest < lastFrame) {
+    lastFrame = 0; // app restarted: frame numbers started over
+    return pullFrames();
+  }
+  lastFrame = data.latest;
+  if (data.latest === 0) return false;
+  for (const ms of data.frameTimeMs) perfHistory.push(ms);
+  return true;
+}
+
+// Refresh loop summaries and append the iterations each loop completed
+// since the last pull
+async function pullLoops() {
+  if (!loopsSupported) return;
+  let data;
+  try {
+    data = await fetchJson('/api/loops');
+  } catch {
+    loopsSupported = false;
+    return;
+  }
+
+  await Promise.all(data.loops.map(async (summary) => {
+    let entry = loopRings.get(summary.name);
+    if (!entry || summary.latest < entry.last) {
+      entry = { ring: new PerfRing(LOOP_HISTORY_SIZE), last: 0 };
+      loopRings.set(summary.name, entry);
+    }
+    if (summary.latest === entry.last) return;
+    const frames = await fetchJson(`/api/loops/${encodeURIComponent(summary.name)}/frames?since=${entry.last}`);
+    for (const ms of frames.durationMs) entry.ring.push(ms);
+    entry.last = frames.latest;
+  }));
+
+  loops.value = data.loops.map(summary => ({ ...summary, ring: loopRings.get(summary.name).ring }));
+  loopOverlap.value = data.overlap;
+}
+
+function clearLoops() {
+  loopRings.clear();
+  loops.value = [];
+  loopOverlap.value = null;
+  loopsSupported = true;
+}
+
+// Refresh gauge summaries and append the samples taken since the last pull
+async function pullGauges() {
+  if (!gaugesSupported) return;
+  let data;
+  try {
+    data = await fetchJson('/api/gauges');
+  } catch {
+    gaugesSupported = false;
+    return;
+  }
+
+  await Promise.all(data.gauges.map(async (summary) => {
+    let entry = gaugeRings.get(summary.name);
+    if (!entry || summary.latest < entry.last) {
+      entry = { ring: new PerfRing(GAUGE_HISTORY_SIZE), last: 0 };
+      gaugeRings.set(summary.name, entry);
+    }
+    if (summary.latest === entry.last) return;
+    const samples = await fetchJson(`/api/gauges/${encodeURIComponent(summary.name)}?since=${entry.last}`);
+    for (const v of samples.values) entry.ring.push(v);
+    entry.last = samples.latest;
+  }));
+
+  gauges.value = data.gauges.map(summary => ({ ...summary, ring: gaugeRings.get(summary.name).ring }));
+}
+
+function clearGauges() {
+  gaugeRings.clear();
+  gauges.value = [];
+  gaugesSupported = true;
 }
 
 function startPerfPolling() {
   stopPerfPolling();
   perfTimer = setInterval(async () => {
     try {
-      const data = await fetchJson('/api/perf');
-      perf.value = data;
-      pushPerfSample(data.frameTimeMs);
+      await pollPerf();
     } catch {
       // Connection poll will handle disconnect
     }
@@ -73,17 +203,152 @@ function stopPerfPolling() {
   }
 }
 
-async function refreshScene() {
-  try {
-    const data = await fetchJson('/api/scene');
-    scene.value = data;
-  } catch {
-    // Ignore, will retry on next connection
+// ---------------------------------------------------------------------------
+// Scene: fetched, decoded and diffed in a Web Worker (see sceneWorker.js)
+// ---------------------------------------------------------------------------
+const sceneWorker = new Worker(new URL('./sceneWorker.js', import.meta.url), { type: 'module' });
+const sceneNodes = new Map();
+let sceneRoots = [];
+let sceneRefresh = null; // in-flight refresh: { promise, resolve }
+
+sceneWorker.onmessage = (e) => {
+  const msg = e.data;
+  if (msg.type === 'patch' && msg.patch && connected.value) {
+    applyScenePatch(msg.patch);
+  }
+  sceneRefresh?.resolve();
+  sceneRefresh = null;
+};
+
+function applyScenePatch(patch) {
+  if (patch.reset) sceneNodes.clear();
+  for (const id of patch.removed) sceneNodes.delete(id);
+
+  const { ids, parentIds, types, names, childCounts, childIds } = patch.upsert;
+  let child = 0;
+  for (let i = 0; i < ids.length; i++) {
+    const count = childCounts[i];
+    sceneNodes.set(ids[i], {
+      id: ids[i],
+      parentId: parentIds[i],
+      type: types[i],
+      name: names[i],
+      children: childIds.slice(child, child + count),
+    });
+    child += count;
+  }
+  if (patch.roots) sceneRoots = patch.roots;
+
+  scene.value = { roots: sceneRoots, nodes: sceneNodes, version: patch.version };
+}
+
+function clearScene() {
+  sceneNodes.clear();
+  sceneRoots = [];
+  scene.value = null;
+  sceneWorker.postMessage({ type: 'reset' });
+}
+
+function refreshScene() {
+  // Coalesce: a refresh already in flight will deliver the newest scene
+  if (!sceneRefresh) {
+    let resolve;
+    const promise = new Promise(r => { resolve = r; });
+    sceneRefresh = { promise, resolve };
+    sceneWorker.postMessage({ type: 'refresh' });
   }
+  return sceneRefresh.promise;
+}
+
+// ---------------------------------------------------------------------------
+// Entities: selecting an entity aborts fetches for anything else, so fast
+// navigation never queues stale requests on the server's few workers.
+// Requests for one id share a fetch, recent results are kept in a small LRU
+// (revalidated by ETag once stale), and once the selection has loaded, its
+// nearest siblings are prefetched one at a time.
+// ---------------------------------------------------------------------------
+const entityCache = new Map();   // id -> { data, etag, at }, least recently used first
+const entityFetches = new Map(); // id -> { promise, controller }
+let selectedEntity = null;
+
+function freshEntity(id) {
+  const entry = entityCache.get(id);
+  if (!entry || performance.now() - entry.at > ENTITY_FRESH_MS) return null;
+  entityCache.delete(id);
+  entityCache.set(id, entry);
+  return entry.data;
 }
 
+function rememberEntity(id, data, etag) {
+  entityCache.delete(id);
+  entityCache.set(id, { data, etag, at: performance.now() });
+  if (entityCache.size > ENTITY_CACHE_SIZE) entityCache.delete(entityCache.keys().next().value);
+}
+
+function loadEntity(id) {
+  const pending = entityFetches.get(id);
+  if (pending) return pending.promise;
+
+  const controller = new AbortController();
+  const cached = entityCache.get(id);
+  const headers = cached?.etag ? { 'If-None-Match': cached.etag } : {};
+  const promise = (async () => {
+    try {
+      const res = await fetch(`/api/entity/${id}`, { cache: 'no-store', headers, signal: controller.signal });
+      if (res.status === 304 && cached) {
+        rememberEntity(id, cached.data, cached.etag);
+        return cached.data;
+      }
+      if (!res.ok) throw new Error(`${res.status}`);
+      const data = await res.json();
+      rememberEntity(id, data, res.headers.get('ETag'));
+      return data;
+    } finally {
+      if (entityFetches.get(id)?.controller === controller) entityFetches.delete(id);
+    }
+  })();
+  entityFetches.set(id, { promise, controller });
+  return promise;
+}
+
+// Rejects with an AbortError if another entity is selected before it loads
 async function fetchEntity(id) {
-  return fetchJson(`/api/entity/${id}`);
+  id = String(id);
+  selectedEntity = id;
+  for (const [other, pending] of entityFetches) {
+    if (other !== id) pending.controller.abort();
+  }
+  const data = freshEntity(id) ?? await loadEntity(id);
+  if (selectedEntity === id) prefetchSiblings(id);
+  return data;
+}
+
+// Stops at the first failure, and as soon as the selection moves (which
+// also aborts the fetch in flight)
+async function prefetchSiblings(id) {
+  const node = sceneNodes.get(id);
+  if (!node) return;
+  const siblings = node.parentId === null ? sceneRoots : sceneNodes.get(node.parentId)?.children ?? [];
+  const i = siblings.indexOf(id);
+  if (i < 0) return;
+
+  for (let d = 1; d <= PREFETCH_SIBLINGS; d++) {
+    for (const sibling of [siblings[i + d], siblings[i - d]]) {
+      if (sibling === undefined || freshEntity(sibling)) continue;
+      if (selectedEntity !== id) return;
+      try {
+        await loadEntity(sibling);
+      } catch {
+        return;
+      }
+    }
+  }
+}
+
+function clearEntities() {
+  for (const pending of entityFetches.values()) pending.controller.abort();
+  entityCache.clear();
+  selectedEntity = null;
 }
 
 // ---------------------------------------------------------------------------
@@ -111,8 +376,12 @@ export function useApi() {
   return {
     connected: readonly(connected),
     perf: readonly(perf),
-    perfHistory: readonly(perfHistory),
-    scene: readonly(scene),
+    perfHistory,
+    perfVersion: readonly(perfVersion),
+    loops: shallowReadonly(loops),
+    loopOverlap: shallowReadonly(loopOverlap),
+    gauges: shallowReadonly(gauges),
+    scene: shallowReadonly(scene),
     fetchEntity,
     refreshScene,
   };
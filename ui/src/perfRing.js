@@ -0,0 +1,43 @@
+// ---------------------------------------------------------------------------
+// Fixed-capacity Float32Array ring of samples with an O(1) amortized running
+// max. Samples are addressed by absolute sequence number: the ring holds
+// [total - length, total).
+// ---------------------------------------------------------------------------
+export class PerfRing {
+  constructor(capacity) {
+    this.capacity = capacity;
+    this.values = new Float32Array(capacity);
+    this.total = 0; // samples ever pushed (sequence number of the next one)
+
+    // Monotonic deque of sequence numbers whose values decrease from head to
+    // tail; the head is the max of the window
+    this.maxQueue = new Float64Array(capacity);
+    this.maxHead = 0;
+    this.maxTail = 0;
+  }
+
+  get length() {
+    return Math.min(this.total, this.capacity);
+  }
+
+  push(value) {
+    const cap = this.capacity;
+    const seq = this.total++;
+    this.values[seq % cap] = value;
+
+    const q = this.maxQueue;
+    while (this.maxTail > this.maxHead && q[this.maxHead % cap] <= seq - cap) this.maxHead++;
+    while (this.maxTail > this.maxHead && this.values[q[(this.maxTail - 1) % cap] % cap] <= value) this.maxTail--;
+    q[this.maxTail++ % cap] = seq;
+  }
+
+  // Value at absolute sequence number `seq` (must still be in the ring)
+  get(seq) {
+    return this.values[seq % this.capacity];
+  }
+
+  max() {
+    if (this.maxTail === this.maxHead) return 0;
+    return this.values[this.maxQueue[this.maxHead % this.capacity] % this.capacity];
+  }
+}
@@ -0,0 +1,117 @@
+// ---------------------------------------------------------------------------
+// Scene worker: fetches /api/scene, decodes it, flattens the tree into a node
+// table and diffs it against the previous snapshot. Only the patch is posted
+// back, so the UI thread never parses or walks the full hierarchy.
+//
+// Patch layout (columnar, cheap to structured-clone):
+//   { version, reset, roots: string[] | null, removed: string[],
+//     upsert: { ids, parentIds, types, names, childCounts: Uint32Array, childIds } }
+// `childIds` holds each upserted node's children back to back, `childCounts`
+// says how many belong to each.
+// ---------------------------------------------------------------------------
+
+let prevNodes = new Map(); // id -> { parentId, type, name, children: string[] }
+let prevRoots = [];
+let prevEtag = null;
+let version = 0;
+
+function sameIds(a, b) {
+  if (a.length !== b.length) return false;
+  for (let i = 0; i < a.length; i++) {
+    if (a[i] !== b[i]) return false;
+  }
+  return true;
+}
+
+async function decode(res) {
+  // JSON is the only encoding the server speaks today; other content types
+  // would be decoded here.
+  return JSON.parse(await res.text());
+}
+
+function flatten(entities) {
+  const nodes = new Map();
+  const stack = [];
+  for (let i = entities.length - 1; i >= 0; i--) stack.push(entities[i], null);
+
+  while (stack.length) {
+    const parentId = stack.pop();
+    const n = stack.pop();
+    const children = n.children ?? [];
+    const childIds = new Array(children.length);
+    for (let i = children.length - 1; i >= 0; i--) {
+      childIds[i] = children[i].id;
+      stack.push(children[i], n.id);
+    }
+    nodes.set(n.id, { parentId, type: n.type, name: n.name ?? null, children: childIds });
+  }
+  return nodes;
+}
+
+function diff(nodes, roots, reset) {
+  const upsert = { ids: [], parentIds: [], types: [], names: [], childCounts: null, childIds: [] };
+  const counts = [];
+  for (const [id, n] of nodes) {
+    const old = reset ? undefined : prevNodes.get(id);
+    if (old && old.parentId === n.parentId && old.type === n.type && old.name === n.name
+        && sameIds(old.children, n.children)) {
+      continue;
+    }
+    upsert.ids.push(id);
+    upsert.parentIds.push(n.parentId);
+    upsert.types.push(n.type);
+    upsert.names.push(n.name);
+    counts.push(n.children.length);
+    for (const c of n.children) upsert.childIds.push(c);
+  }
+  upsert.childCounts = Uint32Array.from(counts);
+
+  const removed = [];
+  if (!reset) {
+    for (const id of prevNodes.keys()) {
+      if (!nodes.has(id)) removed.push(id);
+    }
+  }
+
+  const rootsChanged = reset || !sameIds(prevRoots, roots);
+  return { version: ++version, reset, roots: rootsChanged ? roots : null, removed, upsert };
+}
+
+async function refresh(requestId) {
+  try {
+    // Revalidate ourselves: an unchanged scene costs a 304 and no parsing
+    const headers = prevEtag && prevNodes.size ? { 'If-None-Match': prevEtag } : {};
+    const res = await fetch('/api/scene', { cache: 'no-store', headers });
+    if (res.status === 304) {
+      postMessage({ type: 'patch', requestId, patch: null });
+      return;
+    }
+    if (!res.ok) throw new Error(`${res.status}`);
+    prevEtag = res.headers.get('ETag');
+    const data = await decode(res);
+    const entities = data.entities ?? [];
+    const nodes = flatten(entities);
+    const roots = entities.map(e => e.id);
+    const reset = prevNodes.size === 0;
+    const patch = diff(nodes, roots, reset);
+    prevNodes = nodes;
+    prevRoots = roots;
+
+    const empty = !patch.roots && patch.removed.length === 0 && patch.upsert.ids.length === 0;
+    postMessage({ type: 'patch', requestId, patch: empty ? null : patch },
+      [patch.upsert.childCounts.buffer]);
+  } catch (err) {
+    postMessage({ type: 'error', requestId, message: String(err) });
+  }
+}
+
+onmessage = (e) => {
+  const msg = e.data;
+  if (msg.type === 'refresh') {
+    refresh(msg.requestId);
+  } else if (msg.type === 'reset') {
+    prevNodes = new Map();
+    prevRoots = [];
+    prevEtag = null;
+  }
+};